@@ -0,0 +1,156 @@
+#include <catch.hpp>
+#include <dedup.h>
+#include <parallel_dedup.h>
+#include <string_pool.h>
+#include <streaming_dedup.h>
+
+#include <malloc.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// The original DeDuplicate: two lookups per string and a copy of every unique key.
+std::vector<std::shared_ptr<string>> CopyingDeDuplicate(
+    const std::vector<std::unique_ptr<string>>& items) {
+    std::vector<std::shared_ptr<string>> shared(items.size());
+    std::unordered_map<string, size_t> index_ptr;
+    for (size_t i = 0; i < items.size(); ++i) {
+        if (index_ptr.contains(*items[i])) {
+            shared[i] = shared[index_ptr[*items[i]]];
+        } else {
+            shared[i] = std::make_shared<string>(*items[i]);
+            index_ptr[*items[i]] = i;
+        }
+    }
+    return shared;
+}
+
+template <class F>
+double Milliseconds(F fn) {
+    auto start = std::chrono::steady_clock::now();
+    auto shared = fn();
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+}  // namespace
+
+TEST_CASE("Dedup throughput", "[benchmark]") {
+    const size_t kItems = 10000000;
+
+    std::cout << "hardware threads: " << std::thread::hardware_concurrency() << "\n";
+    std::cout << "unique values\tcopying, ms\tDeDuplicate, ms\tparallel 1/2/4/8 threads, ms\n";
+    for (size_t unique : {1000, 1000000, 10000000}) {
+        std::mt19937 gen(735675);
+        std::uniform_int_distribution<size_t> dist(0, unique - 1);
+        std::vector<std::unique_ptr<string>> items;
+        for (size_t i = 0; i < kItems; ++i) {
+            auto line = "some log line " + std::to_string(dist(gen));
+            items.emplace_back(std::make_unique<string>(std::move(line)));
+        }
+
+        std::cout << unique << "\t" << Milliseconds([&] { return CopyingDeDuplicate(items); })
+                  << "\t" << Milliseconds([&] { return DeDuplicate(items); });
+        for (size_t threads_count : {1, 2, 4, 8}) {
+            std::cout << "\t"
+                      << Milliseconds([&] { return ParallelDeDuplicate(items, threads_count); });
+        }
+        std::cout << "\n";
+    }
+}
+
+namespace {
+
+// Bytes in use on the heap, malloc overhead included.
+size_t HeapBytes() {
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+}  // namespace
+
+TEST_CASE("Interning memory", "[benchmark]") {
+    const size_t kItems = 10000000;
+    const size_t kUnique = 1000000;
+
+    std::cout << "value\tbytes per unique value: DeDuplicate\tStringPool\t"
+                 "bytes per item: DeDuplicate\tStringPool\tDeDuplicate, ms\tInternAll, ms\n";
+    for (const char* prefix : {"", "some log line "}) {
+        std::mt19937 gen(735675);
+        std::uniform_int_distribution<size_t> dist(0, kUnique - 1);
+        std::vector<std::unique_ptr<string>> items;
+        for (size_t i = 0; i < kItems; ++i) {
+            items.emplace_back(std::make_unique<string>(prefix + std::to_string(dist(gen))));
+        }
+
+        size_t before = HeapBytes();
+        auto start = std::chrono::steady_clock::now();
+        auto shared = DeDuplicate(items);
+        std::chrono::duration<double, std::milli> dedup_time =
+            std::chrono::steady_clock::now() - start;
+        size_t shared_bytes = HeapBytes() - before;
+        size_t vector_bytes = shared.capacity() * sizeof(shared[0]);
+        shared = {};
+
+        before = HeapBytes();
+        start = std::chrono::steady_clock::now();
+        auto pool = std::make_unique<StringPool>();
+        auto ids = pool->InternAll(items);
+        std::chrono::duration<double, std::milli> intern_time =
+            std::chrono::steady_clock::now() - start;
+        size_t pool_bytes = HeapBytes() - before;
+        size_t ids_bytes = ids.capacity() * sizeof(ids[0]);
+
+        std::cout << '"' << prefix << "N\"\t"
+                  << static_cast<double>(shared_bytes - vector_bytes) / kUnique << "\t"
+                  << static_cast<double>(pool_bytes - ids_bytes) / pool->Size() << "\t"
+                  << static_cast<double>(shared_bytes) / kItems << "\t"
+                  << static_cast<double>(pool_bytes) / kItems << "\t" << dedup_time.count()
+                  << "\t" << intern_time.count() << "\n";
+    }
+}
+
+TEST_CASE("Streaming dedup", "[benchmark]") {
+    const size_t kRecords = 10000000;
+    const size_t kUnique = 2000000;
+
+    auto dir = std::filesystem::temp_directory_path() / "streaming_dedup_bench";
+    std::filesystem::create_directories(dir);
+    auto input_path = dir / "input";
+    {
+        std::mt19937 gen(735675);
+        std::uniform_int_distribution<size_t> dist(0, kUnique - 1);
+        std::ofstream input(input_path);
+        for (size_t i = 0; i < kRecords; ++i) {
+            input << "2026-10-17 GET /api/v1/items/" << dist(gen) << " 200\n";
+        }
+    }
+
+    std::cout << "input: " << kRecords << " records, " << std::filesystem::file_size(input_path)
+              << " bytes\n";
+    std::cout << "budget, MB\tunique\tpartitions\tspilled records\ttime, ms\n";
+    for (size_t budget_mb : {1024, 64, 16, 4}) {
+        StreamingDedupOptions options;
+        options.memory_budget = budget_mb << 20;
+        options.temp_dir = dir;
+        std::ifstream input(input_path);
+        std::ofstream output(dir / "output");
+        auto start = std::chrono::steady_clock::now();
+        auto stats = StreamingDeDuplicate(input, output, options);
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << budget_mb << "\t" << stats.unique << "\t" << stats.partitions << "\t"
+                  << stats.spilled_records << "\t" << elapsed.count() << "\n";
+    }
+    std::filesystem::remove_all(dir);
+}
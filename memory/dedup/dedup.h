@@ -3,12 +3,14 @@
 #include <memory>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <iostream>
 
 using std::string;
 
-std::vector<std::unique_ptr<string>> Duplicate(const std::vector<std::shared_ptr<string>>& items) {
+inline std::vector<std::unique_ptr<string>> Duplicate(
+    const std::vector<std::shared_ptr<string>>& items) {
     std::vector<std::unique_ptr<string>> unshared;
     for (size_t i = 0; i < items.size(); ++i) {
         unshared.emplace_back(std::make_unique<string>(*items[i]));
@@ -16,16 +18,18 @@ std::vector<std::unique_ptr<string>> Duplicate(const std::vector<std::shared_ptr
     return unshared;
 }
 
-std::vector<std::shared_ptr<string>> DeDuplicate(
+// The index is keyed by views into items, so every string is hashed once
+// and only the shared copies are allocated.
+inline std::vector<std::shared_ptr<string>> DeDuplicate(
     const std::vector<std::unique_ptr<string>>& items) {
     std::vector<std::shared_ptr<string>> shared(items.size());
-    std::unordered_map<string, size_t> index_ptr;
+    std::unordered_map<std::string_view, size_t> index_ptr;
     for (size_t i = 0; i < items.size(); ++i) {
-        if (index_ptr.contains(*items[i])) {
-            shared[i] = shared[index_ptr[*items[i]]];
-        } else {
+        auto [it, inserted] = index_ptr.try_emplace(*items[i], i);
+        if (inserted) {
             shared[i] = std::make_shared<string>(*items[i]);
-            index_ptr[*items[i]] = i;
+        } else {
+            shared[i] = shared[it->second];
         }
     }
     return shared;
@@ -0,0 +1,124 @@
+#include "parallel_dedup.h"
+#include "dedup.h"
+
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+namespace {
+
+// Smaller inputs are not worth starting a thread for.
+const size_t kMinItemsPerThread = 1 << 16;
+
+// Key of a partition's index: a view into the input with its hash, which is
+// computed once in the first phase and then reused by the index.
+struct Key {
+    bool operator==(const Key& rhs) const {
+        return hash == rhs.hash && value == rhs.value;
+    }
+
+    std::string_view value;
+    size_t hash;
+};
+
+struct KeyHash {
+    size_t operator()(const Key& key) const {
+        return key.hash;
+    }
+};
+
+// Runs fn(0), ..., fn(threads_count - 1) in parallel, the first one on the calling
+// thread, and rethrows the first exception once all of them are done.
+template <class F>
+void ParallelFor(size_t threads_count, F fn) {
+    std::vector<std::exception_ptr> errors(threads_count);
+    auto run = [&](size_t index) {
+        try {
+            fn(index);
+        } catch (...) {
+            errors[index] = std::current_exception();
+        }
+    };
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < threads_count; ++i) {
+        threads.emplace_back(run, i);
+    }
+    run(0);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (const auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+}  // namespace
+
+std::vector<std::shared_ptr<std::string>> ParallelDeDuplicate(
+    const std::vector<std::unique_ptr<std::string>>& items, size_t threads_count) {
+    const size_t size = items.size();
+    if (threads_count == 0) {
+        threads_count = std::min<size_t>(std::thread::hardware_concurrency(),
+                                         size / kMinItemsPerThread);
+    }
+    threads_count = std::min(threads_count, size);
+    if (threads_count <= 1) {
+        return DeDuplicate(items);
+    }
+
+    // Thread t hashes the t-th slice of the input and counts how many of its
+    // strings fall into every partition, counts[t * threads_count + p].
+    const size_t partitions_count = threads_count;
+    auto slice_begin = [&](size_t t) { return size * t / threads_count; };
+    std::vector<size_t> hashes(size);
+    std::vector<size_t> counts(threads_count * partitions_count);
+    ParallelFor(threads_count, [&](size_t t) {
+        std::hash<std::string_view> hasher;
+        size_t* slice_counts = &counts[t * partitions_count];
+        for (size_t i = slice_begin(t); i < slice_begin(t + 1); ++i) {
+            hashes[i] = hasher(*items[i]);
+            ++slice_counts[hashes[i] % partitions_count];
+        }
+    });
+
+    // Indices are laid out by partition, then by slice, so every partition
+    // sees its strings in input order and the first occurrence is shared.
+    std::vector<size_t> partition_begin(partitions_count + 1);
+    std::vector<size_t> offsets(counts.size());
+    for (size_t p = 0, offset = 0; p < partitions_count; ++p) {
+        partition_begin[p] = offset;
+        for (size_t t = 0; t < threads_count; ++t) {
+            offsets[t * partitions_count + p] = offset;
+            offset += counts[t * partitions_count + p];
+        }
+    }
+    partition_begin[partitions_count] = size;
+    std::vector<size_t> order(size);
+    ParallelFor(threads_count, [&](size_t t) {
+        size_t* slice_offsets = &offsets[t * partitions_count];
+        for (size_t i = slice_begin(t); i < slice_begin(t + 1); ++i) {
+            order[slice_offsets[hashes[i] % partitions_count]++] = i;
+        }
+    });
+
+    std::vector<std::shared_ptr<std::string>> shared(size);
+    ParallelFor(threads_count, [&](size_t p) {
+        std::unordered_map<Key, size_t, KeyHash> first;
+        first.reserve(partition_begin[p + 1] - partition_begin[p]);
+        for (size_t k = partition_begin[p]; k < partition_begin[p + 1]; ++k) {
+            size_t i = order[k];
+            auto [it, inserted] = first.try_emplace(Key{*items[i], hashes[i]}, i);
+            if (inserted) {
+                shared[i] = std::make_shared<std::string>(*items[i]);
+            } else {
+                shared[i] = shared[it->second];
+            }
+        }
+    });
+    return shared;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// Same as DeDuplicate, but spread over threads_count threads. Strings are hashed
+// in parallel and split into one partition per thread by hash, so equal strings
+// always meet in the same partition. Every partition is then deduplicated on its
+// own, in input order, and writes only its own positions of the result.
+// threads_count = 0 picks a count that suits the input size and the machine.
+std::vector<std::shared_ptr<std::string>> ParallelDeDuplicate(
+    const std::vector<std::unique_ptr<std::string>>& items, size_t threads_count = 0);
@@ -0,0 +1,145 @@
+#include "streaming_dedup.h"
+#include "string_pool.h"
+
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+// Partitions this deep are deduplicated in memory whatever the budget: with the
+// default 64 partitions per level, the input has been split 16M ways by then.
+const int kMaxDepth = 4;
+
+// Every level takes the partition from a differently mixed hash, so that the
+// records of one partition spread over all partitions of the next level.
+size_t PartitionOf(std::string_view record, int depth, size_t partitions_count) {
+    uint64_t h = std::hash<std::string_view>{}(record) + (depth + 1) * 0x9e3779b97f4a7c15;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccd;
+    h ^= h >> 33;
+    return h % partitions_count;
+}
+
+class Deduplicator {
+public:
+    Deduplicator(const StreamingDedupOptions& options, std::ostream& out,
+                 StreamingDedupStats* stats)
+        : options_(options), out_(out), stats_(stats) {
+        std::random_device random;
+        prefix_ = "dedup-" + std::to_string(random()) + std::to_string(random()) + "-";
+    }
+
+    ~Deduplicator() {
+        for (const auto& path : live_files_) {
+            std::error_code error;
+            std::filesystem::remove(path, error);
+        }
+    }
+
+    void Run(std::istream& in, int depth) {
+        StringPool pool;
+        std::vector<std::ofstream> spills;
+        std::vector<std::filesystem::path> paths;
+        std::string record;
+        while (std::getline(in, record)) {
+            if (depth == 0) {
+                ++stats_->records;
+            }
+            if (!spills.empty()) {
+                Spill(record, depth, spills, paths);
+                continue;
+            }
+            size_t size = pool.Size();
+            pool.Intern(record);
+            if (pool.Size() > size && depth < kMaxDepth &&
+                pool.MemoryUsage() > options_.memory_budget) {
+                spills.resize(options_.partitions_count);
+                paths.resize(options_.partitions_count);
+                for (StringPool::Id id = 0; id < pool.Size(); ++id) {
+                    Spill(pool.View(id), depth, spills, paths);
+                }
+                pool = StringPool();
+            }
+        }
+        if (in.bad()) {
+            throw std::runtime_error("StreamingDeDuplicate: failed to read records");
+        }
+
+        if (spills.empty()) {
+            for (StringPool::Id id = 0; id < pool.Size(); ++id) {
+                out_ << pool.View(id) << '\n';
+            }
+            stats_->unique += pool.Size();
+            return;
+        }
+        for (auto& spill : spills) {
+            if (spill.is_open() && !spill.flush()) {
+                throw std::runtime_error("StreamingDeDuplicate: failed to write a partition");
+            }
+        }
+        spills.clear();
+        for (const auto& path : paths) {
+            if (path.empty()) {
+                continue;
+            }
+            {
+                std::ifstream partition(path);
+                if (!partition) {
+                    throw std::runtime_error("StreamingDeDuplicate: failed to open " +
+                                             path.string());
+                }
+                Run(partition, depth + 1);
+            }
+            std::filesystem::remove(path);
+            live_files_.erase(path.string());
+        }
+    }
+
+private:
+    // Partition files are opened on their first record.
+    void Spill(std::string_view record, int depth, std::vector<std::ofstream>& spills,
+               std::vector<std::filesystem::path>& paths) {
+        size_t partition = PartitionOf(record, depth, options_.partitions_count);
+        std::ofstream& spill = spills[partition];
+        if (!spill.is_open()) {
+            auto& path = paths[partition];
+            path = options_.temp_dir / (prefix_ + std::to_string(depth) + "-" +
+                                        std::to_string(partition));
+            live_files_.insert(path.string());
+            spill.open(path, std::ios::binary | std::ios::trunc);
+            if (!spill) {
+                throw std::runtime_error("StreamingDeDuplicate: failed to create " +
+                                         path.string());
+            }
+            ++stats_->partitions;
+        }
+        spill << record << '\n';
+        ++stats_->spilled_records;
+    }
+
+    const StreamingDedupOptions& options_;
+    std::ostream& out_;
+    StreamingDedupStats* stats_;
+    std::string prefix_;
+    // Files to remove if Run is left by an exception.
+    std::set<std::string> live_files_;
+};
+
+}  // namespace
+
+StreamingDedupStats StreamingDeDuplicate(std::istream& in, std::ostream& out,
+                                         const StreamingDedupOptions& options) {
+    StreamingDedupStats stats;
+    Deduplicator(options, out, &stats).Run(in, 0);
+    return stats;
+}
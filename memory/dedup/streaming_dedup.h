@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <iosfwd>
+
+struct StreamingDedupOptions {
+    // Memory the in-memory index may take before records are spilled to disk.
+    size_t memory_budget = size_t{1} << 30;
+    // Number of partitions every spill splits the records into.
+    size_t partitions_count = 64;
+    // Where the partitions are spilled to.
+    std::filesystem::path temp_dir = std::filesystem::temp_directory_path();
+};
+
+struct StreamingDedupStats {
+    // Records read from the input.
+    size_t records = 0;
+    // Distinct records written to the output.
+    size_t unique = 0;
+    // Records written to temporary files, counted once per level of partitioning.
+    size_t spilled_records = 0;
+    // Temporary files created.
+    size_t partitions = 0;
+};
+
+// Writes every distinct newline-delimited record of in to out once, each followed
+// by a newline. Records are deduplicated in a StringPool. Once the pool outgrows
+// options.memory_budget, it and the rest of the input are split by hash into
+// partition files in options.temp_dir, and every partition is then deduplicated
+// on its own the same way, with another hash. Equal records always land in the
+// same partition, so the output has no duplicates, and the memory used stays
+// around the budget however large the input is.
+//
+// If the input fits into the budget, records come out in the order of their first
+// occurrence; otherwise they are grouped by partition. Throws std::runtime_error
+// if a temporary file cannot be written or read; temporary files are removed in
+// any case.
+StreamingDedupStats StreamingDeDuplicate(std::istream& in, std::ostream& out,
+                                         const StreamingDedupOptions& options = {});
@@ -0,0 +1,106 @@
+#include "string_pool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+
+namespace {
+
+const size_t kMinSlotsCount = 16;
+// Linear probing stays short up to a load of about 3/4.
+const size_t kMaxLoadNumerator = 3;
+const size_t kMaxLoadDenominator = 4;
+
+}  // namespace
+
+StringPool::StringPool() : slots_(kMinSlotsCount) {
+}
+
+StringPool::Id StringPool::Intern(std::string_view value) {
+    size_t hash = std::hash<std::string_view>{}(value);
+    size_t pos = Probe(value, hash);
+    if (slots_[pos].id != kNoId) {
+        return slots_[pos].id;
+    }
+    if (views_.size() == kNoId) {
+        throw std::length_error("StringPool is full");
+    }
+    // Grow first, so that a failed allocation leaves the table and views_ in agreement.
+    if ((views_.size() + 1) * kMaxLoadDenominator > slots_.size() * kMaxLoadNumerator) {
+        Rehash(slots_.size() * 2);
+        pos = Probe(value, hash);
+    }
+    Id id = views_.size();
+    views_.emplace_back(Store(value), value.size());
+    slots_[pos] = {static_cast<uint32_t>(hash), id};
+    return id;
+}
+
+std::vector<StringPool::Id> StringPool::InternAll(
+    const std::vector<std::unique_ptr<std::string>>& items) {
+    std::vector<Id> ids(items.size());
+    for (size_t i = 0; i < items.size(); ++i) {
+        ids[i] = Intern(*items[i]);
+    }
+    return ids;
+}
+
+StringPool::Id StringPool::Find(std::string_view value) const {
+    return slots_[Probe(value, std::hash<std::string_view>{}(value))].id;
+}
+
+size_t StringPool::MemoryUsage() const {
+    return sizeof(*this) + arena_bytes_ + chunks_.capacity() * sizeof(chunks_[0]) +
+           views_.capacity() * sizeof(views_[0]) + slots_.capacity() * sizeof(slots_[0]);
+}
+
+size_t StringPool::Probe(std::string_view value, size_t hash) const {
+    size_t mask = slots_.size() - 1;
+    for (size_t pos = hash & mask;; pos = (pos + 1) & mask) {
+        const Slot& slot = slots_[pos];
+        if (slot.id == kNoId ||
+            (slot.hash == static_cast<uint32_t>(hash) && views_[slot.id] == value)) {
+            return pos;
+        }
+    }
+}
+
+const char* StringPool::Store(std::string_view value) {
+    if (value.size() > kMaxSharedLength) {
+        chunks_.push_back(std::make_unique_for_overwrite<char[]>(value.size()));
+        arena_bytes_ += value.size();
+        std::memcpy(chunks_.back().get(), value.data(), value.size());
+        return chunks_.back().get();
+    }
+    if (static_cast<size_t>(free_end_ - free_begin_) < value.size()) {
+        chunks_.push_back(std::make_unique_for_overwrite<char[]>(kChunkSize));
+        arena_bytes_ += kChunkSize;
+        free_begin_ = chunks_.back().get();
+        free_end_ = free_begin_ + kChunkSize;
+    }
+    char* begin = free_begin_;
+    // memcpy must not be called with a null pointer even for empty values.
+    if (!value.empty()) {
+        std::memcpy(begin, value.data(), value.size());
+    }
+    free_begin_ += value.size();
+    return begin;
+}
+
+void StringPool::Rehash(size_t slots_count) {
+    std::vector<Slot> slots(slots_count);
+    size_t mask = slots_count - 1;
+    for (const Slot& slot : slots_) {
+        if (slot.id == kNoId) {
+            continue;
+        }
+        // Only the low 32 bits of the hash are kept, enough for tables of up to 2^32 slots.
+        size_t pos = slot.hash & mask;
+        while (slots[pos].id != kNoId) {
+            pos = (pos + 1) & mask;
+        }
+        slots[pos] = slot;
+    }
+    slots_ = std::move(slots);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Interning pool of strings. Every distinct value is stored once, back to back in
+// an arena of large chunks, and is named by a 32-bit Id, its number in the order
+// of interning. Ids and the views returned by View() stay valid for the lifetime
+// of the pool, since chunks are never moved or freed before it.
+//
+// Compared to DeDuplicate there is no control block and no separate heap string
+// per value, and a reference to a value is 4 bytes with no refcount to update.
+class StringPool {
+public:
+    using Id = uint32_t;
+
+    StringPool();
+
+    // Returns the id of value, adding it to the pool if it is new.
+    // Throws std::length_error once there are 2^32 - 1 distinct values.
+    Id Intern(std::string_view value);
+
+    // Interns every item, res[i] is the id of *items[i].
+    std::vector<Id> InternAll(const std::vector<std::unique_ptr<std::string>>& items);
+
+    // Returns the id of value, or kNoId if it was never interned.
+    Id Find(std::string_view value) const;
+
+    std::string_view View(Id id) const {
+        return views_[id];
+    }
+
+    // Number of distinct values.
+    size_t Size() const {
+        return views_.size();
+    }
+
+    // Bytes held by the pool: the arena, the views and the hash table.
+    size_t MemoryUsage() const;
+
+    static constexpr Id kNoId = UINT32_MAX;
+
+private:
+    // Chunks of the arena hold many short strings each; longer strings get a
+    // chunk of their own so that they do not waste the rest of the current one.
+    static const size_t kChunkSize = 64 * 1024;
+    static const size_t kMaxSharedLength = kChunkSize / 16;
+
+    // The table keeps 32 bits of the hash next to the id, so a probe reads a
+    // value only when those bits match.
+    struct Slot {
+        uint32_t hash = 0;
+        Id id = kNoId;
+    };
+
+    // Position of value in slots_: either its slot or the empty one it would take.
+    size_t Probe(std::string_view value, size_t hash) const;
+    const char* Store(std::string_view value);
+    void Rehash(size_t slots_count);
+
+    std::vector<std::unique_ptr<char[]>> chunks_;
+    size_t arena_bytes_ = 0;
+    char* free_begin_ = nullptr;
+    char* free_end_ = nullptr;
+    std::vector<std::string_view> views_;
+    std::vector<Slot> slots_;
+};
@@ -1,9 +1,18 @@
 #include <dedup.h>
+#include <parallel_dedup.h>
+#include <string_pool.h>
+#include <streaming_dedup.h>
 
 #include <catch.hpp>
 
 #include <string>
 #include <memory>
+#include <algorithm>
+#include <filesystem>
+#include <random>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
 
 using std::string;
 
@@ -66,3 +75,147 @@ TEST_CASE("More duplication") {
         REQUIRE(*unshared[i] == "abacaba");
     }
 }
+
+TEST_CASE("Parallel deduping") {
+    std::mt19937 gen(735675);
+    std::uniform_int_distribution<int> dist(0, 5000);
+    std::vector<std::unique_ptr<string>> unshared;
+    for (int i = 0; i < 100000; ++i) {
+        unshared.emplace_back(std::make_unique<string>("value " + std::to_string(dist(gen))));
+    }
+    unshared.emplace_back(std::make_unique<string>(""));
+    unshared.emplace_back(std::make_unique<string>(""));
+
+    for (size_t threads_count : {0, 1, 2, 3, 8}) {
+        auto shared = ParallelDeDuplicate(unshared, threads_count);
+        REQUIRE(shared.size() == unshared.size());
+        std::unordered_map<string, string*> copies;
+        for (size_t i = 0; i < shared.size(); ++i) {
+            REQUIRE(*shared[i] == *unshared[i]);
+            auto [it, inserted] = copies.emplace(*shared[i], shared[i].get());
+            REQUIRE(it->second == shared[i].get());
+        }
+        REQUIRE(copies.size() <= 5002u);
+    }
+
+    REQUIRE(ParallelDeDuplicate({}, 4).empty());
+}
+
+TEST_CASE("Interning strings") {
+    StringPool pool;
+    auto a = pool.Intern("a");
+    auto b = pool.Intern(string("b"));
+    auto empty = pool.Intern("");
+    REQUIRE(a == 0u);
+    REQUIRE(b == 1u);
+    REQUIRE(pool.Intern("a") == a);
+    REQUIRE(pool.Intern("") == empty);
+    REQUIRE(pool.Find("b") == b);
+    REQUIRE(pool.Find("c") == StringPool::kNoId);
+    REQUIRE(pool.Size() == 3u);
+    REQUIRE(pool.View(empty).empty());
+
+    std::string_view view_a = pool.View(a);
+    const string long_value(100000, 'x');
+    auto long_id = pool.Intern(long_value);
+    std::vector<StringPool::Id> ids;
+    for (int i = 0; i < 100000; ++i) {
+        ids.push_back(pool.Intern(std::to_string(i)));
+    }
+    REQUIRE(pool.View(a).data() == view_a.data());
+    REQUIRE(pool.View(long_id) == long_value);
+    for (int i = 0; i < 100000; ++i) {
+        REQUIRE(pool.View(ids[i]) == std::to_string(i));
+        REQUIRE(pool.Intern(std::to_string(i)) == ids[i]);
+    }
+    REQUIRE(pool.Size() == 100004u);
+}
+
+TEST_CASE("Interning deduplicates like DeDuplicate") {
+    std::vector<std::unique_ptr<string>> unshared;
+    for (const char* value : {"foo", "bar", "bar", "baz", "foo"}) {
+        unshared.emplace_back(std::make_unique<string>(value));
+    }
+
+    StringPool pool;
+    auto ids = pool.InternAll(unshared);
+    REQUIRE(ids == std::vector<StringPool::Id>{0, 1, 1, 2, 0});
+    REQUIRE(pool.View(ids[3]) == "baz");
+    REQUIRE(pool.Size() == 3u);
+}
+
+namespace {
+
+std::vector<string> Lines(const string& text) {
+    std::vector<string> lines;
+    std::istringstream stream(text);
+    for (string line; std::getline(stream, line);) {
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+}  // namespace
+
+TEST_CASE("Streaming dedup in memory") {
+    std::istringstream in("foo\nbar\nbar\n\nbaz\nfoo\n\nqux");
+    std::ostringstream out;
+    auto stats = StreamingDeDuplicate(in, out);
+    REQUIRE(out.str() == "foo\nbar\n\nbaz\nqux\n");
+    REQUIRE(stats.records == 8u);
+    REQUIRE(stats.unique == 5u);
+    REQUIRE(stats.partitions == 0u);
+}
+
+TEST_CASE("Streaming dedup spills partitions") {
+    auto temp_dir = std::filesystem::temp_directory_path() / "streaming_dedup_test";
+    std::filesystem::remove_all(temp_dir);
+    std::filesystem::create_directories(temp_dir);
+
+    std::mt19937 gen(735675);
+    for (size_t unique : {20000, 200000}) {
+        std::uniform_int_distribution<size_t> dist(0, unique - 1);
+        std::ostringstream input;
+        std::vector<string> expected;
+        for (size_t i = 0; i < 4 * unique; ++i) {
+            input << "record " << dist(gen) << "\n";
+        }
+        for (size_t i = 0; i < unique; ++i) {
+            input << "record " << i << "\n";
+            expected.push_back("record " + std::to_string(i));
+        }
+
+        StreamingDedupOptions options;
+        options.memory_budget = 100000;
+        options.temp_dir = temp_dir;
+        std::istringstream in(input.str());
+        std::ostringstream out;
+        auto stats = StreamingDeDuplicate(in, out, options);
+
+        auto lines = Lines(out.str());
+        std::sort(lines.begin(), lines.end());
+        std::sort(expected.begin(), expected.end());
+        REQUIRE(lines == expected);
+        REQUIRE(stats.records == 5 * unique);
+        REQUIRE(stats.unique == unique);
+        // The larger input does not fit even after one split and is split again.
+        REQUIRE(stats.partitions > (unique > 100000 ? 64u : 0u));
+        REQUIRE(stats.spilled_records >= 5 * unique - 5000);
+        REQUIRE(std::filesystem::is_empty(temp_dir));
+    }
+
+    std::filesystem::remove_all(temp_dir);
+}
+
+TEST_CASE("Streaming dedup reports temp file errors") {
+    std::ostringstream input;
+    for (int i = 0; i < 100000; ++i) {
+        input << i << "\n";
+    }
+    StreamingDedupOptions options;
+    options.memory_budget = 100000;
+    options.temp_dir = "/nonexistent/streaming_dedup_test";
+    std::istringstream in(input.str());
+    std::ostringstream out;
+    REQUIRE_THROWS_AS(StreamingDeDuplicate(in, out, options), std::runtime_error);
+}
@@ -0,0 +1,497 @@
+#include <catch.hpp>
+#include <deque.h>
+#include <spsc_queue.h>
+#include <blocking_queue.h>
+#include <fork_join_pool.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <mutex>
+#include <random>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+size_t allocations = 0;
+
+template <class T>
+struct CountingAllocator : std::allocator<T> {
+    template <class U>
+    struct rebind {
+        using other = CountingAllocator<U>;
+    };
+
+    CountingAllocator() = default;
+    template <class U>
+    CountingAllocator(const CountingAllocator<U>&) {
+    }
+
+    T* allocate(size_t n) {
+        ++allocations;
+        return std::allocator<T>::allocate(n);
+    }
+};
+
+struct Result {
+    double ns_per_op;
+    double allocations_per_op;
+};
+
+// Producer pushes a burst of jobs, consumer drains it, over and over. Bursts are
+// shorter than a block, so the queue keeps crossing block edges back and forth.
+template <class Queue, class Push, class Pop>
+Result Measure(const std::vector<int>& bursts, Push push, Pop pop) {
+    Queue queue;
+    allocations = 0;
+    size_t ops = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int burst : bursts) {
+        for (int i = 0; i < burst; ++i) {
+            push(queue, i);
+        }
+        for (int i = 0; i < burst; ++i) {
+            pop(queue);
+        }
+        ops += 2 * burst;
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return {elapsed.count() / ops, static_cast<double>(allocations) / ops};
+}
+
+}  // namespace
+
+TEST_CASE("Oscillating push and pop", "[benchmark]") {
+    const size_t kBursts = 1000000;
+
+    std::mt19937 gen(735675);
+    std::uniform_int_distribution<int> dist(1, 64);
+    std::vector<int> bursts(kBursts);
+    for (auto& burst : bursts) {
+        burst = dist(gen);
+    }
+
+    using OurDeque = Deque<int, CountingAllocator<int>>;
+    using StdDeque = std::deque<int, CountingAllocator<int>>;
+    auto fifo = Measure<OurDeque>(
+        bursts, [](OurDeque& q, int x) { q.PushBack(x); }, [](OurDeque& q) { q.PopFront(); });
+    auto std_fifo = Measure<StdDeque>(
+        bursts, [](StdDeque& q, int x) { q.push_back(x); }, [](StdDeque& q) { q.pop_front(); });
+    auto lifo = Measure<OurDeque>(
+        bursts, [](OurDeque& q, int x) { q.PushFront(x); }, [](OurDeque& q) { q.PopFront(); });
+    auto std_lifo = Measure<StdDeque>(
+        bursts, [](StdDeque& q, int x) { q.push_front(x); }, [](StdDeque& q) { q.pop_front(); });
+
+    std::cout << "pattern\tcontainer\tns per op\tallocations per op\n";
+    std::cout << "fifo\tDeque\t" << fifo.ns_per_op << "\t" << fifo.allocations_per_op << "\n";
+    std::cout << "fifo\tstd::deque\t" << std_fifo.ns_per_op << "\t" << std_fifo.allocations_per_op
+              << "\n";
+    std::cout << "lifo\tDeque\t" << lifo.ns_per_op << "\t" << lifo.allocations_per_op << "\n";
+    std::cout << "lifo\tstd::deque\t" << std_lifo.ns_per_op << "\t" << std_lifo.allocations_per_op
+              << "\n";
+}
+
+TEST_CASE("Iteration and sort", "[benchmark]") {
+    const int kSize = 10000000;
+
+    std::mt19937 gen(735675);
+    Deque<int> deque;
+    std::vector<int> vector;
+    for (int i = 0; i < kSize; ++i) {
+        int value = gen();
+        deque.PushBack(value);
+        vector.push_back(value);
+    }
+
+    auto time = [](auto body) {
+        auto start = std::chrono::steady_clock::now();
+        body();
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count();
+    };
+
+    int64_t sums[3] = {};
+    double by_index = time([&] {
+        for (size_t i = 0; i < deque.Size(); ++i) {
+            sums[0] += deque[i];
+        }
+    });
+    double by_iterator = time([&] {
+        for (int x : deque) {
+            sums[1] += x;
+        }
+    });
+    double by_vector = time([&] {
+        for (int x : vector) {
+            sums[2] += x;
+        }
+    });
+    REQUIRE(sums[0] == sums[2]);
+    REQUIRE(sums[1] == sums[2]);
+
+    double moved = time([&] {
+        Deque<int> other(std::move(deque));
+        deque = std::move(other);
+    });
+
+    double deque_sort = time([&] { std::sort(deque.Begin(), deque.End()); });
+    double vector_sort = time([&] { std::sort(vector.begin(), vector.end()); });
+    REQUIRE(std::equal(vector.begin(), vector.end(), deque.Begin(), deque.End()));
+
+    std::cout << "operation\tms\n";
+    std::cout << "sum Deque by index\t" << by_index << "\n";
+    std::cout << "sum Deque by iterator\t" << by_iterator << "\n";
+    std::cout << "sum vector\t" << by_vector << "\n";
+    std::cout << "move Deque there and back\t" << moved << "\n";
+    std::cout << "sort Deque\t" << deque_sort << "\n";
+    std::cout << "sort vector\t" << vector_sort << "\n";
+}
+
+TEST_CASE("Bulk load", "[benchmark]") {
+    const size_t kSize = 10000000;
+
+    std::vector<int> values(kSize);
+    std::iota(values.begin(), values.end(), 0);
+
+    auto time = [](auto body) {
+        auto start = std::chrono::steady_clock::now();
+        body();
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count();
+    };
+
+    Deque<int> pushed;
+    Deque<int> appended;
+    Deque<int> pushed_front;
+    Deque<int> prepended;
+    std::deque<int> std_deque;
+    double push_back = time([&] {
+        for (int x : values) {
+            pushed.PushBack(x);
+        }
+    });
+    double append = time([&] { appended.Append(values); });
+    double push_front = time([&] {
+        for (auto it = values.rbegin(); it != values.rend(); ++it) {
+            pushed_front.PushFront(*it);
+        }
+    });
+    double prepend = time([&] { prepended.Prepend(values); });
+    double std_insert = time([&] { std_deque.insert(std_deque.end(), values.begin(), values.end()); });
+    REQUIRE(std::equal(values.begin(), values.end(), appended.Begin(), appended.End()));
+    REQUIRE(std::equal(values.begin(), values.end(), prepended.Begin(), prepended.End()));
+
+    double pop_front = time([&] {
+        while (pushed.Size() > 0) {
+            pushed.PopFront();
+        }
+    });
+    double erase_front = time([&] { appended.EraseFront(appended.Size()); });
+
+    Deque<int> zeros;
+    double emplace = time([&] {
+        for (size_t i = 0; i < kSize; ++i) {
+            zeros.EmplaceBack();
+        }
+    });
+    zeros.Clear();
+    double resize = time([&] { zeros.Resize(kSize); });
+
+    std::cout << "operation on " << kSize << " ints\tms\n";
+    std::cout << "PushBack loop\t" << push_back << "\n";
+    std::cout << "Append\t" << append << "\n";
+    std::cout << "PushFront loop\t" << push_front << "\n";
+    std::cout << "Prepend\t" << prepend << "\n";
+    std::cout << "std::deque insert\t" << std_insert << "\n";
+    std::cout << "PopFront loop\t" << pop_front << "\n";
+    std::cout << "EraseFront\t" << erase_front << "\n";
+    std::cout << "EmplaceBack loop\t" << emplace << "\n";
+    std::cout << "Resize\t" << resize << "\n";
+}
+
+namespace {
+
+template <size_t kBlockBytes, size_t kBlockAlignment = alignof(int)>
+void SweepBlockSize(const std::vector<int>& values, const std::vector<size_t>& indices) {
+    auto time = [](auto body) {
+        auto start = std::chrono::steady_clock::now();
+        body();
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count();
+    };
+
+    Deque<int, std::allocator<int>, kBlockBytes, kBlockAlignment> deque;
+    double push = time([&] {
+        for (int x : values) {
+            deque.PushBack(x);
+        }
+    });
+    int64_t sums[2] = {};
+    double random = time([&] {
+        for (size_t i : indices) {
+            sums[0] += deque[i];
+        }
+    });
+    double scan = time([&] {
+        for (int x : deque) {
+            sums[1] += x;
+        }
+    });
+    // The whole deque slides through memory as a queue.
+    double slide = time([&] {
+        for (int x : values) {
+            deque.PushBack(x);
+            deque.PopFront();
+        }
+    });
+    REQUIRE(sums[0] != 0);
+    REQUIRE(sums[1] != 0);
+
+    std::cout << kBlockBytes << "\t" << kBlockAlignment << "\t" << push << "\t" << random << "\t"
+              << scan << "\t" << slide << "\n";
+}
+
+}  // namespace
+
+TEST_CASE("Block size sweep", "[benchmark]") {
+    const size_t kSize = 10000000;
+
+    std::mt19937 gen(735675);
+    std::vector<int> values(kSize);
+    std::iota(values.begin(), values.end(), 1);
+    std::vector<size_t> indices(kSize);
+    std::uniform_int_distribution<size_t> dist(0, kSize - 1);
+    for (auto& index : indices) {
+        index = dist(gen);
+    }
+
+    std::cout << "block bytes\talignment\tPushBack, ms\trandom [], ms\tscan, ms\tPushBack+PopFront, ms\n";
+    SweepBlockSize<128>(values, indices);
+    SweepBlockSize<512>(values, indices);
+    SweepBlockSize<1024>(values, indices);
+    SweepBlockSize<kPageSize>(values, indices);
+    SweepBlockSize<4 * kPageSize>(values, indices);
+    SweepBlockSize<16 * kPageSize>(values, indices);
+    SweepBlockSize<512, kCacheLineSize>(values, indices);
+    SweepBlockSize<kPageSize, kCacheLineSize>(values, indices);
+    SweepBlockSize<kPageSize, kPageSize>(values, indices);
+}
+
+TEST_CASE("Shrink after spike", "[benchmark]") {
+    const size_t kPeak = 50000000;
+    const size_t kRest = 1000;
+
+    auto drain = [&](bool auto_shrink) {
+        Deque<int> deque;
+        deque.SetAutoShrink(auto_shrink);
+        deque.Resize(kPeak);
+        size_t peak = deque.MemoryUsage();
+        auto start = std::chrono::steady_clock::now();
+        while (deque.Size() > kRest) {
+            deque.PopFront();
+        }
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        size_t drained = deque.MemoryUsage();
+        deque.ShrinkToFit();
+        std::cout << (auto_shrink ? "on" : "off") << "\t" << peak << "\t" << drained << "\t"
+                  << deque.MemoryUsage() << "\t" << elapsed.count() << "\n";
+    };
+
+    std::cout << "auto shrink\tbytes at " << kPeak << "\tbytes at " << kRest
+              << "\tafter ShrinkToFit\tPopFront loop, ms\n";
+    drain(false);
+    drain(true);
+}
+
+namespace {
+
+// Runs a producer and a consumer passing kMessages integers in batches of the
+// given size through push and pop, which return how many they moved.
+template <class Push, class Pop>
+double MessagesPerSecond(size_t batch_size, Push push, Pop pop) {
+    const size_t kMessages = 20000000;
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread producer([batch_size, &push] {
+        std::vector<int> batch(batch_size);
+        for (size_t sent = 0; sent < kMessages;) {
+            size_t count = std::min(batch_size, kMessages - sent);
+            size_t pushed = push(std::span(batch).first(count));
+            if (pushed == 0) {
+                std::this_thread::yield();
+            }
+            sent += pushed;
+        }
+    });
+    std::vector<int> batch(batch_size);
+    for (size_t received = 0; received < kMessages;) {
+        size_t popped = pop(std::span(batch));
+        if (popped == 0) {
+            std::this_thread::yield();
+        }
+        received += popped;
+    }
+    producer.join();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return kMessages / elapsed.count();
+}
+
+}  // namespace
+
+TEST_CASE("SPSC queue against mutex", "[benchmark]") {
+    const size_t kCapacity = 4096;
+
+    std::cout << "batch\tmutex Deque, M msgs/s\tSpscQueue, M msgs/s\n";
+    for (size_t batch_size : {1, 16, 256}) {
+        std::mutex mutex;
+        Deque<int> deque;
+        double locked = MessagesPerSecond(
+            batch_size,
+            [&](std::span<const int> values) {
+                std::lock_guard<std::mutex> lock(mutex);
+                size_t count = std::min(values.size(), kCapacity - deque.Size());
+                for (size_t i = 0; i < count; ++i) {
+                    deque.PushBack(values[i]);
+                }
+                return count;
+            },
+            [&](std::span<int> values) {
+                std::lock_guard<std::mutex> lock(mutex);
+                size_t count = std::min(values.size(), deque.Size());
+                for (size_t i = 0; i < count; ++i) {
+                    values[i] = deque[0];
+                    deque.PopFront();
+                }
+                return count;
+            });
+
+        SpscQueue<int> queue(kCapacity);
+        double lock_free = MessagesPerSecond(
+            batch_size, [&](std::span<const int> values) { return queue.PushMany(values); },
+            [&](std::span<int> values) { return queue.PopMany(values); });
+
+        std::cout << batch_size << "\t" << locked / 1e6 << "\t" << lock_free / 1e6 << "\n";
+    }
+}
+
+namespace {
+
+// Producers push kMessages integers in total through a BlockingQueue, consumers
+// pop them one by one or in batches. Returns messages per second.
+double BlockingQueueThroughput(size_t producers_count, size_t consumers_count, size_t batch_size) {
+    const size_t kMessages = 4000000;
+    const size_t kCapacity = 1024;
+
+    BlockingQueue<int> queue(kCapacity);
+    std::atomic<size_t> received = 0;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < producers_count; ++i) {
+        threads.emplace_back([&, i] {
+            size_t count = kMessages / producers_count + (i < kMessages % producers_count);
+            for (size_t j = 0; j < count; ++j) {
+                queue.Push(j);
+            }
+        });
+    }
+    for (size_t i = 0; i < consumers_count; ++i) {
+        threads.emplace_back([&] {
+            std::vector<int> batch(batch_size);
+            size_t count = 0;
+            if (batch_size == 1) {
+                int value;
+                while (queue.Pop(&value)) {
+                    ++count;
+                }
+            } else {
+                while (size_t popped = queue.PopMany(batch)) {
+                    count += popped;
+                }
+            }
+            received += count;
+        });
+    }
+    for (size_t i = 0; i < producers_count; ++i) {
+        threads[i].join();
+    }
+    queue.Close();
+    for (size_t i = producers_count; i < threads.size(); ++i) {
+        threads[i].join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    REQUIRE(received == kMessages);
+    return kMessages / elapsed.count();
+}
+
+}  // namespace
+
+TEST_CASE("Blocking queue contention", "[benchmark]") {
+    std::cout << "hardware threads: " << std::thread::hardware_concurrency() << "\n";
+    std::cout << "producers\tconsumers\tPop, M msgs/s\tPopMany(64), M msgs/s\n";
+    for (size_t producers_count : {1, 2, 4, 8}) {
+        for (size_t consumers_count : {1, 2, 4, 8}) {
+            double single = BlockingQueueThroughput(producers_count, consumers_count, 1);
+            double batched = BlockingQueueThroughput(producers_count, consumers_count, 64);
+            std::cout << producers_count << "\t" << consumers_count << "\t" << single / 1e6 << "\t"
+                      << batched / 1e6 << "\n";
+        }
+    }
+}
+
+namespace {
+
+int64_t Fib(ForkJoinPool& pool, int n) {
+    // Below the cutoff a task is too small to pay for being stolen.
+    if (n < 20) {
+        return n < 2 ? n : Fib(pool, n - 1) + Fib(pool, n - 2);
+    }
+    int64_t left = 0;
+    int64_t right = 0;
+    pool.Join([&] { left = Fib(pool, n - 1); }, [&] { right = Fib(pool, n - 2); });
+    return left + right;
+}
+
+int64_t Sum(ForkJoinPool& pool, const int* begin, const int* end) {
+    if (end - begin < 100000) {
+        return std::accumulate(begin, end, int64_t{0});
+    }
+    const int* middle = begin + (end - begin) / 2;
+    int64_t left = 0;
+    int64_t right = 0;
+    pool.Join([&] { left = Sum(pool, begin, middle); }, [&] { right = Sum(pool, middle, end); });
+    return left + right;
+}
+
+}  // namespace
+
+TEST_CASE("Fork-join scaling", "[benchmark]") {
+    const int kFib = 34;
+    const size_t kSumSize = 100000000;
+
+    std::vector<int> values(kSumSize, 1);
+    std::cout << "hardware threads: " << std::thread::hardware_concurrency() << "\n";
+    std::cout << "threads\tfib(" << kFib << "), ms\tsum of " << kSumSize << ", ms\n";
+    for (size_t threads : {1, 2, 4, 8, 16}) {
+        ForkJoinPool pool(threads);
+        int64_t fib = 0;
+        auto start = std::chrono::steady_clock::now();
+        pool.Run([&] { fib = Fib(pool, kFib); });
+        std::chrono::duration<double, std::milli> fib_time = std::chrono::steady_clock::now() - start;
+        REQUIRE(fib == 5702887);
+
+        int64_t sum = 0;
+        start = std::chrono::steady_clock::now();
+        pool.Run([&] { sum = Sum(pool, values.data(), values.data() + values.size()); });
+        std::chrono::duration<double, std::milli> sum_time = std::chrono::steady_clock::now() - start;
+        REQUIRE(sum == static_cast<int64_t>(kSumSize));
+
+        std::cout << threads << "\t" << fib_time.count() << "\t" << sum_time.count() << "\n";
+    }
+}
@@ -0,0 +1,190 @@
+#pragma once
+
+#include "deque.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <utility>
+
+// Bounded blocking queue for any number of producer and consumer threads. Elements
+// live in a Deque under one mutex; a full queue makes producers wait instead of
+// growing it. After Close() pushes fail, and pops fail once the queue is drained.
+template <class T, class Alloc = std::allocator<T>>
+class BlockingQueue {
+public:
+    explicit BlockingQueue(size_t capacity, const Alloc& alloc = Alloc())
+        : capacity_(std::max<size_t>(1, capacity)), elements_(alloc) {
+    }
+
+    BlockingQueue(const BlockingQueue&) = delete;
+    BlockingQueue& operator=(const BlockingQueue&) = delete;
+
+    // Waits while the queue is full. Returns false if it is closed.
+    bool Push(const T& value) {
+        return PushUntil(value, std::nullopt);
+    }
+    bool Push(T&& value) {
+        return PushUntil(std::move(value), std::nullopt);
+    }
+
+    // Returns false if the queue is full or closed.
+    bool TryPush(const T& value) {
+        return PushUntil(value, kNoWait);
+    }
+    bool TryPush(T&& value) {
+        return PushUntil(std::move(value), kNoWait);
+    }
+
+    // Returns false if the queue is still full after timeout, or closed.
+    template <class Rep, class Period>
+    bool TryPushFor(const T& value, const std::chrono::duration<Rep, Period>& timeout) {
+        return PushUntil(value, Clock::now() + timeout);
+    }
+    template <class Rep, class Period>
+    bool TryPushFor(T&& value, const std::chrono::duration<Rep, Period>& timeout) {
+        return PushUntil(std::move(value), Clock::now() + timeout);
+    }
+
+    // Waits while the queue is empty. Returns false if it is closed and drained.
+    bool Pop(T* value) {
+        return PopUntil(value, std::nullopt);
+    }
+
+    // Returns false if the queue is empty.
+    bool TryPop(T* value) {
+        return PopUntil(value, kNoWait);
+    }
+
+    // Returns false if the queue is still empty after timeout, or closed and drained.
+    template <class Rep, class Period>
+    bool TryPopFor(T* value, const std::chrono::duration<Rep, Period>& timeout) {
+        return PopUntil(value, Clock::now() + timeout);
+    }
+
+    // Waits while the queue is empty, then moves up to values.size() elements out
+    // under one lock. Returns the number of elements moved, 0 if the queue is
+    // closed and drained. An empty span returns 0 at once, without waiting.
+    size_t PopMany(std::span<T> values) {
+        if (values.empty()) {
+            return 0;
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!WaitUntil(lock, not_empty_, waiting_consumers_, std::nullopt, [this] {
+                return closed_ || elements_.Size() > 0;
+            })) {
+            return 0;
+        }
+        size_t count = std::min(values.size(), elements_.Size());
+        std::move(elements_.Begin(), elements_.Begin() + count, values.begin());
+        elements_.EraseFront(count);
+        bool wake = waiting_producers_ > 0;
+        lock.unlock();
+        if (wake) {
+            if (count > 1) {
+                not_full_.notify_all();
+            } else {
+                not_full_.notify_one();
+            }
+        }
+        return count;
+    }
+
+    // Wakes up all waiting threads.
+    void Close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+        }
+        not_full_.notify_all();
+        not_empty_.notify_all();
+    }
+
+    size_t Size() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return elements_.Size();
+    }
+
+    size_t Capacity() const {
+        return capacity_;
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // A deadline that has always passed, for the Try methods.
+    static constexpr Clock::time_point kNoWait{};
+
+    // Waits on cv until ready() holds or the deadline passes, no deadline means
+    // forever. Threads only count themselves as waiters here, so that the other
+    // side notifies only if somebody actually sleeps.
+    template <class Ready>
+    bool WaitUntil(std::unique_lock<std::mutex>& lock, std::condition_variable& cv,
+                   size_t& waiters, std::optional<Clock::time_point> deadline, Ready ready) {
+        if (ready()) {
+            return true;
+        }
+        if (deadline == kNoWait) {
+            return false;
+        }
+        ++waiters;
+        bool is_ready = true;
+        if (deadline) {
+            is_ready = cv.wait_until(lock, *deadline, ready);
+        } else {
+            cv.wait(lock, ready);
+        }
+        --waiters;
+        return is_ready;
+    }
+
+    template <class U>
+    bool PushUntil(U&& value, std::optional<Clock::time_point> deadline) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!WaitUntil(lock, not_full_, waiting_producers_, deadline, [this] {
+                return closed_ || elements_.Size() < capacity_;
+            }) ||
+            closed_) {
+            return false;
+        }
+        elements_.PushBack(std::forward<U>(value));
+        bool wake = waiting_consumers_ > 0;
+        lock.unlock();
+        if (wake) {
+            not_empty_.notify_one();
+        }
+        return true;
+    }
+
+    bool PopUntil(T* value, std::optional<Clock::time_point> deadline) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!WaitUntil(lock, not_empty_, waiting_consumers_, deadline, [this] {
+                return closed_ || elements_.Size() > 0;
+            }) ||
+            elements_.Size() == 0) {
+            return false;
+        }
+        *value = std::move(elements_[0]);
+        elements_.PopFront();
+        bool wake = waiting_producers_ > 0;
+        lock.unlock();
+        if (wake) {
+            not_full_.notify_one();
+        }
+        return true;
+    }
+
+    const size_t capacity_;
+    mutable std::mutex mutex_;
+    std::condition_variable not_full_;
+    std::condition_variable not_empty_;
+    Deque<T, Alloc> elements_;
+    size_t waiting_producers_ = 0;
+    size_t waiting_consumers_ = 0;
+    bool closed_ = false;
+};
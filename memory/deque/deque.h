@@ -2,248 +2,705 @@
 
 #include <initializer_list>
 #include <algorithm>
-#include <deque>
-#include <iostream>
+#include <bit>
+#include <compare>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <new>
+#include <span>
+#include <utility>
 
+inline constexpr size_t kCacheLineSize = 64;
+inline constexpr size_t kPageSize = 4096;
+
+// Fixed-size chunk of raw storage of about kBytes bytes that Deque and SpscQueue
+// allocate elements in. It holds nothing but elements. By default it is aligned
+// as T; passing kCacheLineSize or kPageSize as kAlignment opts in to blocks that
+// never share a cache line with a neighbour, at the price of a slower aligned
+// allocation for every new block.
+template <class T, size_t kBytes = 512, size_t kAlignment = alignof(T)>
+struct DequeBlock {
+    static constexpr size_t kSize = std::max<size_t>(1, kBytes / sizeof(T));
+
+    T* Slot(size_t i) {
+        return std::launder(reinterpret_cast<T*>(storage)) + i;
+    }
+    const T* Slot(size_t i) const {
+        return std::launder(reinterpret_cast<const T*>(storage)) + i;
+    }
+
+    alignas(std::max(kAlignment, alignof(T))) unsigned char storage[sizeof(T) * kSize];
+};
+
+// kBlockBytes is the size of one block in bytes, such as kPageSize, and
+// kBlockAlignment is the alignment of its storage, see DequeBlock.
+template <class T = int, class Alloc = std::allocator<T>, size_t kBlockBytes = 512,
+          size_t kBlockAlignment = alignof(T)>
 class Deque {
+    struct Block;
+
 public:
-    Deque() = default;
-    Deque(const Deque& rhs) {
-        for (size_t i = 0; i < rhs.Size(); i++) {
-            PushBack(rhs[i]);
+    using value_type = T;
+    using allocator_type = Alloc;
+
+    // Random access iterator that keeps the bounds of its current block, so
+    // that stepping within a block is a pointer increment and a comparison.
+    // Invalidated by any insertion or removal.
+    template <bool kIsConst>
+    class BasicIterator {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = std::conditional_t<kIsConst, const T*, T*>;
+        using reference = std::conditional_t<kIsConst, const T&, T&>;
+
+        BasicIterator() = default;
+        template <bool kOtherIsConst>
+        requires(kIsConst && !kOtherIsConst)
+        BasicIterator(const BasicIterator<kOtherIsConst>& other)
+            : deque_(other.deque_),
+              index_(other.index_),
+              cur_(other.cur_),
+              block_begin_(other.block_begin_),
+              block_end_(other.block_end_) {
         }
-    }
-    Deque(Deque&& rhs) {
-        for (size_t i = 0; i < rhs.Size(); i++) {
-            PushBack(rhs[i]);
+
+        reference operator*() const {
+            return *cur_;
         }
-    };
-    explicit Deque(size_t size) {
-        for (size_t i = 0; i < size; ++i) {
-            PushBack(0);
+        pointer operator->() const {
+            return cur_;
+        }
+        reference operator[](difference_type n) const {
+            return *(*this + n);
         }
-    }
 
-    Deque(std::initializer_list<int> list) {
-        for (auto i : list) {
-            PushBack(i);
+        BasicIterator& operator++() {
+            ++index_;
+            if (++cur_ == block_end_) {
+                Seek();
+            }
+            return *this;
         }
-    }
-    ~Deque() {
-        Clear();
-        delete[] data_;
-    }
-    Deque& operator=(Deque rhs) {
-        if (rhs.Size() == 0 && Size() == 0) {
+        BasicIterator operator++(int) {
+            auto old = *this;
+            ++*this;
+            return old;
+        }
+        BasicIterator& operator--() {
+            --index_;
+            if (cur_ == block_begin_) {
+                Seek();
+            } else {
+                --cur_;
+            }
             return *this;
         }
-        if (data_[beg_] == rhs.data_[rhs.beg_]) {
+        BasicIterator operator--(int) {
+            auto old = *this;
+            --*this;
+            return old;
+        }
+
+        BasicIterator& operator+=(difference_type n) {
+            index_ += n;
+            if (n >= block_begin_ - cur_ && n < block_end_ - cur_) {
+                cur_ += n;
+            } else {
+                Seek();
+            }
             return *this;
         }
+        BasicIterator& operator-=(difference_type n) {
+            return *this += -n;
+        }
+        friend BasicIterator operator+(BasicIterator it, difference_type n) {
+            return it += n;
+        }
+        friend BasicIterator operator+(difference_type n, BasicIterator it) {
+            return it += n;
+        }
+        friend BasicIterator operator-(BasicIterator it, difference_type n) {
+            return it -= n;
+        }
+        friend difference_type operator-(const BasicIterator& lhs, const BasicIterator& rhs) {
+            return static_cast<difference_type>(lhs.index_ - rhs.index_);
+        }
+
+        bool operator==(const BasicIterator& rhs) const {
+            return index_ == rhs.index_;
+        }
+        std::strong_ordering operator<=>(const BasicIterator& rhs) const {
+            return index_ <=> rhs.index_;
+        }
+
+    private:
+        friend class Deque;
+        template <bool>
+        friend class BasicIterator;
+
+        BasicIterator(const Deque* deque, size_t index) : deque_(deque), index_(index) {
+            Seek();
+        }
+
+        // Past the end there is no block, and dereferencing is not allowed anyway.
+        void Seek() {
+            if (index_ < deque_->size_) {
+                cur_ = deque_->SlotOf(index_, &block_begin_, &block_end_);
+            } else {
+                cur_ = block_begin_ = block_end_ = nullptr;
+            }
+        }
+
+        const Deque* deque_ = nullptr;
+        size_t index_ = 0;
+        T* cur_ = nullptr;
+        T* block_begin_ = nullptr;
+        T* block_end_ = nullptr;
+    };
+
+    using Iterator = BasicIterator<false>;
+    using ConstIterator = BasicIterator<true>;
+
+    Deque() = default;
+    // type_identity keeps Deque(5) from deducing Alloc = int.
+    explicit Deque(const std::type_identity_t<Alloc>& alloc) : alloc_(alloc) {
+    }
+    Deque(const Deque& rhs)
+        : alloc_(std::allocator_traits<Alloc>::select_on_container_copy_construction(rhs.alloc_)),
+          auto_shrink_(rhs.auto_shrink_) {
+        for (size_t i = 0, blocks = rhs.BlockCount(); i < blocks; ++i) {
+            const Block* block = &rhs.data_[(rhs.beg_ + i) & (rhs.capacity_ - 1)];
+            Append(std::span<const T>(block->Slot(block->beg), block->Size()));
+        }
+    }
+    // Steals the block map, rhs is left empty.
+    Deque(Deque&& rhs) noexcept : alloc_(rhs.alloc_) {
+        Swap(rhs);
+    }
+    explicit Deque(size_t size, const Alloc& alloc = Alloc()) : alloc_(alloc) {
+        Resize(size);
+    }
+
+    Deque(std::initializer_list<T> list, const Alloc& alloc = Alloc()) : alloc_(alloc) {
+        Append(std::span<const T>(list.begin(), list.size()));
+    }
+    ~Deque() {
+        // Clearing must not shrink the map: a destructor should not allocate.
+        auto_shrink_ = false;
         Clear();
+        for (size_t i = 0; i < free_blocks_count_; ++i) {
+            DeallocateBlock(free_blocks_[i]);
+        }
+        DeallocateMap(data_, capacity_);
+    }
+    // Takes rhs by value, so that assigning an rvalue only moves the block map.
+    Deque& operator=(Deque rhs) noexcept {
         Swap(rhs);
         return *this;
     }
 
-    void Swap(Deque& rhs) {
-        if (rhs.Size() == 0 && Size() == 0) {
-            return;
-        }
-        if (data_[beg_] == rhs.data_[rhs.beg_]) {
-            return;
-        }
+    void Swap(Deque& rhs) noexcept {
+        std::swap(alloc_, rhs.alloc_);
         std::swap(data_, rhs.data_);
         std::swap(beg_, rhs.beg_);
         std::swap(end_, rhs.end_);
         std::swap(size_, rhs.size_);
         std::swap(capacity_, rhs.capacity_);
+        std::swap(free_blocks_, rhs.free_blocks_);
+        std::swap(free_blocks_count_, rhs.free_blocks_count_);
+        std::swap(auto_shrink_, rhs.auto_shrink_);
     }
     size_t size_ = 0;
     size_t beg_ = 0;
     size_t end_ = 0;
-    void PushBack(int value) {
-        if (size_ == 0) {
-            beg_ = 0;
-            end_ = 0;
-            data_[0] = new Block();
-            size_++;
-            data_[0]->PushBack(value);
-            return;
-        }
-        if (data_[end_]->end_ == kSizeOfBlock - 1) {
-            if (GetNext(end_) == beg_) {
-                Rebase();
+
+    void PushBack(const T& value) {
+        EmplaceBack(value);
+    }
+    void PushBack(T&& value) {
+        EmplaceBack(std::move(value));
+    }
+
+    template <class... Args>
+    T& EmplaceBack(Args&&... args) {
+        Block* block = BackBlockWithRoom();
+        T* slot = block->Slot(block->end);
+        try {
+            std::allocator_traits<Alloc>::construct(alloc_, slot, std::forward<Args>(args)...);
+        } catch (...) {
+            if (block->Size() == 0) {
+                RetireBlock(block);
+                end_ = GetPrev(end_);
             }
-            end_++;
-            data_[end_] = new Block();
+            throw;
         }
-        data_[end_]->PushBack(value);
+        ++block->end;
         ++size_;
+        return *slot;
     }
 
     void PopBack() {
-        data_[end_]->PopBack();
-        if (data_[end_]->Size() == 0) {
-            delete data_[end_];
-            end_ = (end_ + capacity_ - 1) % capacity_;
-        }
+        Block* block = &data_[end_];
+        --block->end;
+        std::allocator_traits<Alloc>::destroy(alloc_, block->Slot(block->end));
         --size_;
+        if (block->Size() == 0) {
+            RetireBlock(block);
+            end_ = GetPrev(end_);
+            MaybeShrink();
+        }
     }
 
-    void PushFront(int value) {
-        if (size_ == 0) {
-            beg_ = 0;
-            end_ = 0;
-            data_[0] = new Block();
-            data_[0]->PushBack(value);
-            size_++;
-            return;
-        }
-        if (data_[beg_]->beg_ == 0) {
-            if (GetPrev(beg_) == end_) {
-                Rebase();
-            }
-            if (beg_ == 0) {
-                beg_ = capacity_;
+    void PushFront(const T& value) {
+        EmplaceFront(value);
+    }
+    void PushFront(T&& value) {
+        EmplaceFront(std::move(value));
+    }
+
+    template <class... Args>
+    T& EmplaceFront(Args&&... args) {
+        Block* block = FrontBlockWithRoom();
+        T* slot = block->Slot(block->beg - 1);
+        try {
+            std::allocator_traits<Alloc>::construct(alloc_, slot, std::forward<Args>(args)...);
+        } catch (...) {
+            if (block->Size() == 0) {
+                RetireBlock(block);
+                beg_ = GetNext(beg_);
             }
-            --beg_;
-            data_[beg_] = new Block();
+            throw;
         }
-
-        data_[beg_]->PushFront(value);
+        --block->beg;
         ++size_;
+        return *slot;
     }
 
     void PopFront() {
-        data_[beg_]->PopFront();
-        if (data_[beg_]->Size() == 0) {
-            delete data_[beg_];
-            beg_ = (beg_ + 1) % capacity_;
-        }
+        Block* block = &data_[beg_];
+        std::allocator_traits<Alloc>::destroy(alloc_, block->Slot(block->beg));
+        ++block->beg;
         --size_;
+        if (block->Size() == 0) {
+            RetireBlock(block);
+            beg_ = GetNext(beg_);
+            MaybeShrink();
+        }
     }
 
-    int& operator[](size_t ind) {
-        size_t sz = data_[beg_]->Size();
-        if (sz > ind) {
-            return data_[beg_]->Get(ind);
+    // The bulk operations below fill or empty a whole block at a time and copy
+    // trivially copyable elements with memcpy. If copying an element throws,
+    // the blocks filled before it stay in the deque.
+    void Append(std::span<const T> values) {
+        GrowBack(values.size(), [this, values](T* slot, size_t first, size_t count) {
+            CopyConstruct(slot, values.data() + first, count);
+        });
+    }
+
+    // Inserts values at the front, keeping their order.
+    void Prepend(std::span<const T> values) {
+        GrowFront(values.size(), [this, values](T* slot, size_t first, size_t count) {
+            CopyConstruct(slot, values.data() + first, count);
+        });
+    }
+
+    void EraseFront(size_t count) {
+        while (count > 0) {
+            Block* block = &data_[beg_];
+            size_t erased = std::min(count, block->Size());
+            Destroy(block->Slot(block->beg), erased);
+            block->beg += erased;
+            size_ -= erased;
+            count -= erased;
+            if (block->Size() == 0) {
+                RetireBlock(block);
+                beg_ = GetNext(beg_);
+            }
+        }
+        MaybeShrink();
+    }
+
+    void EraseBack(size_t count) {
+        while (count > 0) {
+            Block* block = &data_[end_];
+            size_t erased = std::min(count, block->Size());
+            block->end -= erased;
+            Destroy(block->Slot(block->end), erased);
+            size_ -= erased;
+            count -= erased;
+            if (block->Size() == 0) {
+                RetireBlock(block);
+                end_ = GetPrev(end_);
+            }
         }
-        return data_[(beg_ + 1 + static_cast<int>(ind - sz) / kSizeOfBlock) % capacity_]->Get(
-            (ind - sz) % kSizeOfBlock);
+        MaybeShrink();
     }
 
-    int operator[](size_t ind) const {
-        size_t sz = data_[beg_]->Size();
-        if (sz > ind) {
-            return data_[beg_]->Get(ind);
+    // New elements are value-initialized, so ints become zeros.
+    void Resize(size_t size) {
+        if (size < size_) {
+            EraseBack(size_ - size);
+            return;
         }
-        return data_[(beg_ + 1 + static_cast<int>(ind - sz) / kSizeOfBlock) % capacity_]->Get(
-            (ind - sz) % kSizeOfBlock);
+        GrowBack(size - size_, [this](T* slot, size_t, size_t count) {
+            DefaultConstruct(slot, count);
+        });
+    }
+
+    T& operator[](size_t ind) {
+        return *SlotOf(ind);
+    }
+
+    const T& operator[](size_t ind) const {
+        return *SlotOf(ind);
     }
 
     size_t Size() const {
         return size_;
     }
 
+    Iterator Begin() {
+        return Iterator(this, 0);
+    }
+    Iterator End() {
+        return Iterator(this, size_);
+    }
+    ConstIterator Begin() const {
+        return ConstIterator(this, 0);
+    }
+    ConstIterator End() const {
+        return ConstIterator(this, size_);
+    }
+
     void Clear() {
-        size_t i = 0;
-        while (size_) {
-            size_ -= data_[beg_]->Size();
-            delete data_[beg_];
-            ++i;
-            ++beg_;
-            if (beg_ == capacity_) {
-                beg_ = 0;
-            }
-        }
+        EraseFront(size_);
         beg_ = 0;
         end_ = 0;
     }
-    size_t capacity_ = 1;
+    size_t capacity_ = 0;
 
-private:
-    static const size_t kSizeOfBlock = 128;
-    class Block {
-    public:
-        Block() {
+    // Frees the spare blocks kept for reuse and shrinks the block map to the
+    // smallest power of two that holds the blocks in use.
+    void ShrinkToFit() {
+        while (free_blocks_count_ > 0) {
+            DeallocateBlock(free_blocks_[--free_blocks_count_]);
+        }
+        size_t blocks = BlockCount();
+        if (blocks == 0) {
+            DeallocateMap(data_, capacity_);
+            data_ = nullptr;
+            capacity_ = 0;
             beg_ = 0;
             end_ = 0;
-            size_ = 0;
-        };
-        int Get(size_t i) const {
-            return vec[beg_ + i];
-        }
-        int& Get(size_t i) {
-            return vec[beg_ + i];
-        }
-        void PopBack() {
-            --end_;
-            --size_;
-        }
-        void PopFront() {
-            ++beg_;
-            --size_;
-        }
-        void PushBack(int i) {
-            if (size_ == 0) {
-                beg_ = 0;
-                end_ = 0;
-                vec[end_] = i;
-                ++size_;
-                return;
-            }
-            vec[end_ + 1] = i;
-            ++end_;
-            ++size_;
-        }
-        void PushFront(int i) {
-            if (size_ == 0) {
-                beg_ = kSizeOfBlock;
-                end_ = kSizeOfBlock - 1;
-            }
-            vec[beg_ - 1] = i;
-            --beg_;
-            ++size_;
-        }
-        int vec[kSizeOfBlock];
-        size_t beg_ = 0;
-        size_t end_ = 0;
-        size_t size_ = 0;
+        } else if (std::bit_ceil(blocks) < capacity_) {
+            Reallocate(std::bit_ceil(blocks));
+        }
+    }
+
+    // With auto shrink on, the block map is cut once at most an eighth of it is
+    // in use, down to a size it fills from a quarter to a half. A deque hovering
+    // around either threshold thus does not reallocate the map back and forth.
+    void SetAutoShrink(bool enabled) {
+        auto_shrink_ = enabled;
+        MaybeShrink();
+    }
+
+    // Bytes held by the deque: the object, its block map, the blocks in use and
+    // the spare ones.
+    size_t MemoryUsage() const {
+        return sizeof(*this) + capacity_ * sizeof(Block) +
+               (BlockCount() + free_blocks_count_) * sizeof(Storage);
+    }
+
+private:
+    using Storage = DequeBlock<T, kBlockBytes, kBlockAlignment>;
+
+    static constexpr size_t kSizeOfBlock = Storage::kSize;
+    // A queue oscillating around a block edge would otherwise allocate and free
+    // a block on every crossing, so a few emptied blocks are kept for reuse.
+    static const size_t kMaxFreeBlocks = 4;
+    // Auto shrink leaves maps this small alone.
+    static constexpr size_t kMinShrinkCapacity = 64;
+
+    // An entry of the block map. Slots [beg, end) of the storage hold constructed
+    // elements, the rest is raw memory. The bounds are kept in the map, next to
+    // those of the neighbouring blocks, rather than in the block itself.
+    struct Block {
         size_t Size() const {
-            return size_;
+            return end - beg;
+        }
+        T* Slot(size_t i) const {
+            return storage->Slot(i);
         }
+
+        Storage* storage;
+        size_t beg;
+        size_t end;
     };
+
+    // Elements are copied with memcpy and skip destruction only when the
+    // allocator does not construct them itself.
+    static constexpr bool kTrivialElements =
+        std::is_trivially_copyable_v<T> &&
+        !requires(Alloc& alloc, T* slot, const T& value) { alloc.construct(slot, value); };
+
+    using BlockAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<Storage>;
+    using MapAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<Block>;
+
+    // The capacity of the map is always a power of two.
     size_t GetNext(size_t i) const {
-        if (i + 1 == capacity_) {
-            return 0;
-        }
-        return i + 1;
+        return (i + 1) & (capacity_ - 1);
     }
     size_t GetPrev(size_t i) const {
-        if (i == 0) {
-            return capacity_ - 1;
-        }
-        return i - 1;
+        return (i - 1) & (capacity_ - 1);
     }
-    Block** data_ = new Block*[1];
 
-    void Rebase() {
+    size_t BlockCount() const {
+        return size_ == 0 ? 0 : ((end_ - beg_) & (capacity_ - 1)) + 1;
+    }
 
-        capacity_ *= 2;
+    // Returns the last block if it has free slots at its back, or appends a new one.
+    Block* BackBlockWithRoom() {
+        if (size_ == 0) {
+            if (capacity_ == 0) {
+                Rebase();
+            }
+            beg_ = 0;
+            end_ = 0;
+            NewBlock(0, 0);
+        } else if (data_[end_].end == kSizeOfBlock) {
+            if (GetNext(end_) == beg_) {
+                Rebase();
+            }
+            end_ = GetNext(end_);
+            NewBlock(end_, 0);
+        }
+        return &data_[end_];
+    }
 
-        Block** a = new Block*[capacity_];
-        size_t sz = 0;
+    Block* FrontBlockWithRoom() {
         if (size_ == 0) {
-            a[0] = std::move(data_[beg_]);
+            if (capacity_ == 0) {
+                Rebase();
+            }
+            beg_ = 0;
+            end_ = 0;
+            NewBlock(0, kSizeOfBlock);
+        } else if (data_[beg_].beg == 0) {
+            if (GetPrev(beg_) == end_) {
+                Rebase();
+            }
+            beg_ = GetPrev(beg_);
+            NewBlock(beg_, kSizeOfBlock);
+        }
+        return &data_[beg_];
+    }
+
+    // Adds count elements at the back, a block at a time. fill(slot, first, n)
+    // constructs elements first..first+n-1 in n raw slots, all of them or none.
+    template <class Fill>
+    void GrowBack(size_t count, Fill fill) {
+        for (size_t done = 0; done < count;) {
+            Block* block = BackBlockWithRoom();
+            size_t filled = std::min(count - done, kSizeOfBlock - block->end);
+            try {
+                fill(block->Slot(block->end), done, filled);
+            } catch (...) {
+                if (block->Size() == 0) {
+                    RetireBlock(block);
+                    end_ = GetPrev(end_);
+                }
+                throw;
+            }
+            block->end += filled;
+            size_ += filled;
+            done += filled;
+        }
+    }
+
+    // Same as GrowBack, but fills the front blocks starting from the last element.
+    template <class Fill>
+    void GrowFront(size_t count, Fill fill) {
+        for (size_t left = count; left > 0;) {
+            Block* block = FrontBlockWithRoom();
+            size_t filled = std::min(left, block->beg);
+            left -= filled;
+            try {
+                fill(block->Slot(block->beg - filled), left, filled);
+            } catch (...) {
+                if (block->Size() == 0) {
+                    RetireBlock(block);
+                    beg_ = GetNext(beg_);
+                }
+                throw;
+            }
+            block->beg -= filled;
+            size_ += filled;
+        }
+    }
+
+    void CopyConstruct(T* slot, const T* values, size_t count) {
+        if constexpr (kTrivialElements) {
+            std::memcpy(slot, values, count * sizeof(T));
         } else {
-            for (size_t i = 0; sz < size_; ++i) {
-                a[i] = std::move(data_[(i + beg_) % (capacity_ / 2)]);
-                sz += a[i]->Size();
-                end_ = i;
+            size_t i = 0;
+            try {
+                for (; i < count; ++i) {
+                    std::allocator_traits<Alloc>::construct(alloc_, slot + i, values[i]);
+                }
+            } catch (...) {
+                Destroy(slot, i);
+                throw;
+            }
+        }
+    }
+
+    void DefaultConstruct(T* slot, size_t count) {
+        if constexpr (kTrivialElements) {
+            std::uninitialized_value_construct_n(slot, count);
+        } else {
+            size_t i = 0;
+            try {
+                for (; i < count; ++i) {
+                    std::allocator_traits<Alloc>::construct(alloc_, slot + i);
+                }
+            } catch (...) {
+                Destroy(slot, i);
+                throw;
+            }
+        }
+    }
+
+    void Destroy(T* slot, size_t count) {
+        if constexpr (!kTrivialElements) {
+            for (size_t i = 0; i < count; ++i) {
+                std::allocator_traits<Alloc>::destroy(alloc_, slot + i);
             }
         }
-        std::swap(data_, a);
-        delete[] a;
+    }
+
+    // Only the first block may have free slots at its front,
+    // and only the last one at its back.
+    T* SlotOf(size_t ind) const {
+        const Block* first = &data_[beg_];
+        if (first->Size() > ind) {
+            return first->Slot(first->beg + ind);
+        }
+        ind -= first->Size();
+        return data_[(beg_ + 1 + ind / kSizeOfBlock) & (capacity_ - 1)].Slot(ind % kSizeOfBlock);
+    }
+
+    // Also reports the constructed slots of the block the element is in.
+    T* SlotOf(size_t ind, T** block_begin, T** block_end) const {
+        const Block* block = &data_[beg_];
+        if (block->Size() <= ind) {
+            ind -= block->Size();
+            block = &data_[(beg_ + 1 + ind / kSizeOfBlock) & (capacity_ - 1)];
+            ind = ind % kSizeOfBlock + block->beg;
+        } else {
+            ind += block->beg;
+        }
+        *block_begin = block->Slot(block->beg);
+        *block_end = block->Slot(block->end);
+        return block->Slot(ind);
+    }
+
+    // Puts a block into map entry index. Both its ends are at start, which is 0
+    // to grow it to the back and kSizeOfBlock to grow it to the front.
+    void NewBlock(size_t index, size_t start) {
+        Storage* storage;
+        if (free_blocks_count_ > 0) {
+            storage = free_blocks_[--free_blocks_count_];
+        } else {
+            BlockAlloc alloc(alloc_);
+            storage = std::allocator_traits<BlockAlloc>::allocate(alloc, 1);
+            ::new (storage) Storage;
+        }
+        data_[index] = {storage, start, start};
+    }
+
+    void RetireBlock(Block* block) {
+        if (free_blocks_count_ < kMaxFreeBlocks) {
+            free_blocks_[free_blocks_count_++] = block->storage;
+        } else {
+            DeallocateBlock(block->storage);
+        }
+    }
+
+    void DeallocateBlock(Storage* storage) {
+        BlockAlloc alloc(alloc_);
+        std::allocator_traits<BlockAlloc>::deallocate(alloc, storage, 1);
+    }
+
+    void DeallocateMap(Block* map, size_t capacity) {
+        if (map) {
+            MapAlloc alloc(alloc_);
+            std::allocator_traits<MapAlloc>::deallocate(alloc, map, capacity);
+        }
+    }
+
+    [[no_unique_address]] Alloc alloc_;
+    Block* data_ = nullptr;
+    Storage* free_blocks_[kMaxFreeBlocks] = {};
+    size_t free_blocks_count_ = 0;
+    bool auto_shrink_ = false;
+
+    void Rebase() {
+        Reallocate(std::max<size_t>(1, capacity_ * 2));
+    }
+
+    void MaybeShrink() {
+        if (auto_shrink_ && capacity_ > kMinShrinkCapacity && BlockCount() * 8 <= capacity_) {
+            try {
+                Reallocate(std::max(std::bit_ceil(2 * BlockCount()), kMinShrinkCapacity));
+            } catch (const std::bad_alloc&) {
+                // Shrinking is only an optimization, the old map still works.
+            }
+        }
+    }
+
+    // Moves the block map into a new one of the given power of two capacity,
+    // which must hold all the blocks in use.
+    void Reallocate(size_t capacity) {
+        MapAlloc alloc(alloc_);
+        Block* a = std::allocator_traits<MapAlloc>::allocate(alloc, capacity);
+        size_t blocks = BlockCount();
+        for (size_t i = 0; i < blocks; ++i) {
+            a[i] = data_[(i + beg_) & (capacity_ - 1)];
+        }
+        DeallocateMap(data_, capacity_);
+        data_ = a;
+        capacity_ = capacity;
         beg_ = 0;
+        end_ = blocks == 0 ? 0 : blocks - 1;
     }
 };
+
+template <class T, class Alloc, size_t kBlockBytes, size_t kBlockAlignment>
+typename Deque<T, Alloc, kBlockBytes, kBlockAlignment>::Iterator begin(  // NOLINT
+    Deque<T, Alloc, kBlockBytes, kBlockAlignment>& deque) {
+    return deque.Begin();
+}
+
+template <class T, class Alloc, size_t kBlockBytes, size_t kBlockAlignment>
+typename Deque<T, Alloc, kBlockBytes, kBlockAlignment>::Iterator end(  // NOLINT
+    Deque<T, Alloc, kBlockBytes, kBlockAlignment>& deque) {
+    return deque.End();
+}
+
+template <class T, class Alloc, size_t kBlockBytes, size_t kBlockAlignment>
+typename Deque<T, Alloc, kBlockBytes, kBlockAlignment>::ConstIterator begin(  // NOLINT
+    const Deque<T, Alloc, kBlockBytes, kBlockAlignment>& deque) {
+    return deque.Begin();
+}
+
+template <class T, class Alloc, size_t kBlockBytes, size_t kBlockAlignment>
+typename Deque<T, Alloc, kBlockBytes, kBlockAlignment>::ConstIterator end(  // NOLINT
+    const Deque<T, Alloc, kBlockBytes, kBlockAlignment>& deque) {
+    return deque.End();
+}
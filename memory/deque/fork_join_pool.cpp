@@ -0,0 +1,158 @@
+#include "fork_join_pool.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace {
+
+// Rounds of failed stealing before an idle worker goes to sleep.
+const int kIdleRoundsBeforeSleep = 64;
+// Sleeping workers also wake up on their own, wakeups are sent without the lock held.
+const auto kSleepTimeout = std::chrono::milliseconds(1);
+
+thread_local const void* current_pool = nullptr;
+thread_local size_t current_index = 0;
+
+}  // namespace
+
+void ForkJoinPool::Task::Run() {
+    try {
+        Execute();
+    } catch (...) {
+        error_ = std::current_exception();
+    }
+    // Sequentially consistent, like waiting_: either RunTask sees a waiter, or the
+    // waiter sees the task done before it goes to sleep.
+    done_.store(true);
+}
+
+bool ForkJoinPool::Task::IsDone() const {
+    return done_.load();
+}
+
+void ForkJoinPool::Task::RethrowIfFailed() const {
+    if (error_) {
+        std::rethrow_exception(error_);
+    }
+}
+
+ForkJoinPool::ForkJoinPool(size_t threads_count)
+    : threads_count_(std::max<size_t>(1, threads_count)),
+      workers_(std::make_unique<Worker[]>(threads_count_)) {
+    for (size_t i = 0; i < threads_count_; ++i) {
+        workers_[i].thread = std::thread([this, i] { WorkerLoop(i); });
+    }
+}
+
+ForkJoinPool::~ForkJoinPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (size_t i = 0; i < threads_count_; ++i) {
+        workers_[i].thread.join();
+    }
+}
+
+size_t ForkJoinPool::ThreadsCount() const {
+    return threads_count_;
+}
+
+int ForkJoinPool::WorkerIndex() const {
+    return current_pool == this ? static_cast<int>(current_index) : -1;
+}
+
+void ForkJoinPool::WorkerLoop(size_t index) {
+    current_pool = this;
+    current_index = index;
+    int idle_rounds = 0;
+    while (!stop_.load(std::memory_order_acquire)) {
+        if (Task* task = FindTask(index)) {
+            RunTask(task);
+            idle_rounds = 0;
+        } else if (++idle_rounds < kIdleRoundsBeforeSleep) {
+            std::this_thread::yield();
+        } else {
+            std::unique_lock<std::mutex> lock(mutex_);
+            ++sleeping_;
+            wake_.wait_for(lock, kSleepTimeout, [this] { return stop_ || injected_.Size() > 0; });
+            --sleeping_;
+            idle_rounds = 0;
+        }
+    }
+}
+
+ForkJoinPool::Task* ForkJoinPool::FindTask(size_t index) {
+    Task* task = nullptr;
+    if (workers_[index].tasks.Pop(&task)) {
+        return task;
+    }
+    if (injected_count_.load(std::memory_order_relaxed) > 0) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (injected_.Size() > 0) {
+            task = injected_[0];
+            injected_.PopFront();
+            --injected_count_;
+            return task;
+        }
+    }
+    for (size_t i = 1; i < threads_count_; ++i) {
+        if (workers_[(index + i) % threads_count_].tasks.Steal(&task)) {
+            return task;
+        }
+    }
+    return nullptr;
+}
+
+void ForkJoinPool::Push(size_t index, Task* task) {
+    workers_[index].tasks.Push(task);
+    if (sleeping_.load(std::memory_order_relaxed) > 0) {
+        wake_.notify_one();
+    }
+}
+
+void ForkJoinPool::Submit(Task* task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        injected_.PushBack(task);
+        ++injected_count_;
+    }
+    wake_.notify_one();
+}
+
+void ForkJoinPool::RunTask(Task* task) {
+    task->Run();
+    if (waiting_.load() > 0) {
+        // Taking the lock makes sure a waiter that has checked the task is asleep.
+        {
+            std::lock_guard<std::mutex> lock(done_mutex_);
+        }
+        task_done_.notify_all();
+    }
+}
+
+void ForkJoinPool::WaitFor(const Task& task) {
+    std::unique_lock<std::mutex> lock(done_mutex_);
+    ++waiting_;
+    task_done_.wait(lock, [&task] { return task.IsDone(); });
+    --waiting_;
+}
+
+void ForkJoinPool::Complete(size_t index, Task* task) {
+    Task* other = nullptr;
+    // Everything pushed after task has been taken back by the Join calls that pushed it.
+    if (workers_[index].tasks.Pop(&other)) {
+        RunTask(other);
+        if (other == task) {
+            return;
+        }
+    }
+    while (!task->IsDone()) {
+        if ((other = FindTask(index))) {
+            RunTask(other);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "deque.h"
+#include "work_stealing_deque.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+// Thread pool for fork-join parallelism. Every worker keeps its tasks in a
+// WorkStealingDeque; idle workers steal the oldest, and so usually the largest,
+// tasks of the others.
+class ForkJoinPool {
+public:
+    explicit ForkJoinPool(size_t threads_count = std::thread::hardware_concurrency());
+    ~ForkJoinPool();
+
+    ForkJoinPool(const ForkJoinPool&) = delete;
+    ForkJoinPool& operator=(const ForkJoinPool&) = delete;
+
+    // Runs fn on a worker and waits for it, rethrowing its exception if any.
+    template <class F>
+    void Run(F&& fn);
+
+    // Runs left and right, in parallel if some worker is idle, and returns once both
+    // are done. Outside of the workers of this pool runs them one after another.
+    // If both throw, the exception of left wins.
+    template <class F, class G>
+    void Join(F&& left, G&& right);
+
+    size_t ThreadsCount() const;
+
+private:
+    class Task {
+    public:
+        void Run();
+        bool IsDone() const;
+        void RethrowIfFailed() const;
+
+    protected:
+        ~Task() = default;
+        virtual void Execute() = 0;
+
+    private:
+        std::atomic<bool> done_ = false;
+        std::exception_ptr error_;
+    };
+
+    template <class F>
+    class FunctionTask final : public Task {
+    public:
+        explicit FunctionTask(F& fn) : fn_(fn) {
+        }
+
+    private:
+        void Execute() override {
+            fn_();
+        }
+
+        F& fn_;
+    };
+
+    // Aligned so that the indices of neighbouring deques never share a cache line.
+    struct alignas(64) Worker {
+        WorkStealingDeque<Task*> tasks;
+        std::thread thread;
+    };
+
+    // Index of the calling thread among the workers of this pool, -1 for other threads.
+    int WorkerIndex() const;
+    void WorkerLoop(size_t index);
+    Task* FindTask(size_t index);
+    void Push(size_t index, Task* task);
+    void Submit(Task* task);
+    // Runs task and wakes up the threads blocked in WaitFor. They are woken up
+    // through the pool, since the task may be destroyed as soon as it is seen done.
+    void RunTask(Task* task);
+    // Blocks until task is done, for threads that have nothing else to do.
+    void WaitFor(const Task& task);
+    // Takes task back from the worker's deque and runs it, or, if it was stolen,
+    // runs other tasks until the thief is done with it.
+    void Complete(size_t index, Task* task);
+
+    size_t threads_count_;
+    std::unique_ptr<Worker[]> workers_;
+    std::atomic<bool> stop_ = false;
+    std::atomic<size_t> sleeping_ = 0;
+
+    // Tasks submitted by threads outside of the pool.
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    Deque<Task*> injected_;
+    std::atomic<size_t> injected_count_ = 0;
+
+    // Threads outside of the pool waiting in WaitFor.
+    std::mutex done_mutex_;
+    std::condition_variable task_done_;
+    std::atomic<size_t> waiting_ = 0;
+};
+
+template <class F>
+void ForkJoinPool::Run(F&& fn) {
+    if (WorkerIndex() >= 0) {
+        fn();
+        return;
+    }
+    FunctionTask<F> task(fn);
+    Submit(&task);
+    WaitFor(task);
+    task.RethrowIfFailed();
+}
+
+template <class F, class G>
+void ForkJoinPool::Join(F&& left, G&& right) {
+    int index = WorkerIndex();
+    if (index < 0) {
+        left();
+        right();
+        return;
+    }
+    FunctionTask<G> task(right);
+    Push(index, &task);
+    try {
+        left();
+    } catch (...) {
+        // Another worker may be running right, which lives on this stack frame.
+        Complete(index, &task);
+        throw;
+    }
+    Complete(index, &task);
+    task.RethrowIfFailed();
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+#include "deque.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <utility>
+
+// Bounded lock-free queue for exactly one producer thread and one consumer thread.
+// Elements live in a ring of cache-line aligned DequeBlock chunks, allocated once.
+// head_ and tail_ count popped and pushed elements from the start and only grow,
+// so the slot of an element is found by masking, like the block ring of Deque.
+template <class T, class Alloc = std::allocator<T>>
+class SpscQueue {
+public:
+    // Capacity is rounded up to a power of two number of blocks.
+    explicit SpscQueue(size_t capacity, const Alloc& alloc = Alloc()) : alloc_(alloc) {
+        blocks_count_ = std::bit_ceil(std::max<size_t>(
+            1, (capacity + Block::kSize - 1) / Block::kSize));
+        capacity_ = blocks_count_ * Block::kSize;
+        MapAlloc map_alloc(alloc_);
+        BlockAlloc block_alloc(alloc_);
+        blocks_ = std::allocator_traits<MapAlloc>::allocate(map_alloc, blocks_count_);
+        size_t allocated = 0;
+        try {
+            for (; allocated < blocks_count_; ++allocated) {
+                blocks_[allocated] = std::allocator_traits<BlockAlloc>::allocate(block_alloc, 1);
+            }
+        } catch (...) {
+            for (size_t i = 0; i < allocated; ++i) {
+                std::allocator_traits<BlockAlloc>::deallocate(block_alloc, blocks_[i], 1);
+            }
+            std::allocator_traits<MapAlloc>::deallocate(map_alloc, blocks_, blocks_count_);
+            throw;
+        }
+    }
+
+    ~SpscQueue() {
+        for (size_t i = head_.load(); i != tail_.load(); ++i) {
+            std::allocator_traits<Alloc>::destroy(alloc_, SlotOf(i));
+        }
+        MapAlloc map_alloc(alloc_);
+        BlockAlloc block_alloc(alloc_);
+        for (size_t i = 0; i < blocks_count_; ++i) {
+            std::allocator_traits<BlockAlloc>::deallocate(block_alloc, blocks_[i], 1);
+        }
+        std::allocator_traits<MapAlloc>::deallocate(map_alloc, blocks_, blocks_count_);
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // Producer side. Returns false if the queue is full.
+    template <class... Args>
+    bool TryEmplace(Args&&... args) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - cached_head_ == capacity_) {
+            cached_head_ = head_.load(std::memory_order_acquire);
+            if (tail - cached_head_ == capacity_) {
+                return false;
+            }
+        }
+        std::allocator_traits<Alloc>::construct(alloc_, SlotOf(tail), std::forward<Args>(args)...);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+    bool TryPush(const T& value) {
+        return TryEmplace(value);
+    }
+    bool TryPush(T&& value) {
+        return TryEmplace(std::move(value));
+    }
+
+    // Producer side. Copies the longest prefix of values that fits and
+    // publishes it at once. Returns its length. If a copy throws, the elements
+    // copied before it are published and the exception is rethrown.
+    size_t PushMany(std::span<const T> values) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (capacity_ - (tail - cached_head_) < values.size()) {
+            cached_head_ = head_.load(std::memory_order_acquire);
+        }
+        size_t count = std::min(values.size(), capacity_ - (tail - cached_head_));
+        size_t done = 0;
+        try {
+            for (; done < count; ++done) {
+                std::allocator_traits<Alloc>::construct(alloc_, SlotOf(tail + done), values[done]);
+            }
+        } catch (...) {
+            tail_.store(tail + done, std::memory_order_release);
+            throw;
+        }
+        tail_.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    // Consumer side. Returns false if the queue is empty.
+    bool TryPop(T* value) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == cached_tail_) {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            if (head == cached_tail_) {
+                return false;
+            }
+        }
+        T* slot = SlotOf(head);
+        *value = std::move(*slot);
+        std::allocator_traits<Alloc>::destroy(alloc_, slot);
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. Moves up to values.size() elements out and frees
+    // their slots at once. Returns the number of elements moved. If a move
+    // throws, the elements moved before it are popped and the exception is
+    // rethrown.
+    size_t PopMany(std::span<T> values) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (cached_tail_ - head < values.size()) {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+        }
+        size_t count = std::min(values.size(), cached_tail_ - head);
+        size_t done = 0;
+        try {
+            for (; done < count; ++done) {
+                T* slot = SlotOf(head + done);
+                values[done] = std::move(*slot);
+                std::allocator_traits<Alloc>::destroy(alloc_, slot);
+            }
+        } catch (...) {
+            head_.store(head + done, std::memory_order_release);
+            throw;
+        }
+        head_.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    size_t Capacity() const {
+        return capacity_;
+    }
+
+    // Exact only when called from the producer or the consumer while the other is idle.
+    // head_ is read first: it never passes tail_, so the difference cannot wrap.
+    size_t SizeApprox() const {
+        size_t head = head_.load(std::memory_order_acquire);
+        return tail_.load(std::memory_order_acquire) - head;
+    }
+
+private:
+    // The blocks are allocated once, so aligning them costs nothing, and the
+    // producer and the consumer never share a cache line across a block edge.
+    using Block = DequeBlock<T, 512, kCacheLineSize>;
+    using BlockAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<Block>;
+    using MapAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<Block*>;
+
+    T* SlotOf(size_t i) const {
+        return blocks_[(i / Block::kSize) & (blocks_count_ - 1)]->Slot(i % Block::kSize);
+    }
+
+    [[no_unique_address]] Alloc alloc_;
+    Block** blocks_ = nullptr;
+    size_t blocks_count_ = 0;
+    size_t capacity_ = 0;
+
+    // Each side keeps its index and its stale copy of the other side's index on its
+    // own cache line, and rereads the other side only when the copy says it must wait.
+    alignas(64) std::atomic<size_t> head_ = 0;
+    size_t cached_tail_ = 0;
+    alignas(64) std::atomic<size_t> tail_ = 0;
+    size_t cached_head_ = 0;
+};
@@ -1,13 +1,27 @@
 #include <catch.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <numeric>
+#include <stdexcept>
+#include <iostream>
+#include <memory>
+#include <span>
 #include <string>
+#include <thread>
 #include <vector>
 #include <random>
 #include <deque>
 
 #include <deque.h>
+#include <spsc_queue.h>
+#include <blocking_queue.h>
+#include <work_stealing_deque.h>
+#include <fork_join_pool.h>
 
-void Check(const Deque& actual, const std::vector<int>& expected) {
+void Check(const Deque<int>& actual, const std::vector<int>& expected) {
     REQUIRE(actual.Size() == expected.size());
     for (size_t i = 0; i < actual.Size(); ++i) {
         REQUIRE(actual[i] == expected[i]);
@@ -232,3 +246,739 @@ TEST_CASE("Correct work of cycled buffer") {
     }
     Check(b, std::vector<int>(w.begin(), w.end()));
 }
+
+namespace {
+
+size_t allocations = 0;
+// Allocations not yet freed, and how many there may be before allocate throws.
+size_t live_allocations = 0;
+size_t live_allocations_limit = SIZE_MAX;
+
+template <class T>
+struct CountingAllocator : std::allocator<T> {
+    template <class U>
+    struct rebind {
+        using other = CountingAllocator<U>;
+    };
+
+    CountingAllocator() = default;
+    template <class U>
+    CountingAllocator(const CountingAllocator<U>&) {
+    }
+
+    T* allocate(size_t n) {
+        if (live_allocations == live_allocations_limit) {
+            throw std::bad_alloc();
+        }
+        ++allocations;
+        ++live_allocations;
+        return std::allocator<T>::allocate(n);
+    }
+    void deallocate(T* p, size_t n) {
+        --live_allocations;
+        std::allocator<T>::deallocate(p, n);
+    }
+};
+
+}  // namespace
+
+TEST_CASE("Non-trivial elements", "[deque]") {
+    Deque<std::string> a{"b", "c"};
+    a.PushFront("a");
+    a.EmplaceBack(3, 'd');
+    REQUIRE(a.Size() == 4u);
+    REQUIRE(a[0] == "a");
+    REQUIRE(a[3] == "ddd");
+
+    std::deque<std::string> b(a.Size());
+    for (size_t i = 0; i < a.Size(); ++i) {
+        b[i] = a[i];
+    }
+    for (int i = 0; i < 1000; ++i) {
+        auto value = std::string(50, 'a' + i % 26);
+        if (i % 3 == 0) {
+            a.PushFront(value);
+            b.push_front(value);
+        } else {
+            a.PushBack(value);
+            b.push_back(value);
+        }
+    }
+    for (int i = 0; i < 500; ++i) {
+        a.PopFront();
+        b.pop_front();
+        a.PopBack();
+        b.pop_back();
+    }
+    REQUIRE(a.Size() == b.size());
+    for (size_t i = 0; i < a.Size(); ++i) {
+        REQUIRE(a[i] == b[i]);
+    }
+
+    Deque<std::string> c(a);
+    a.Clear();
+    REQUIRE(c.Size() == b.size());
+    REQUIRE(c[0] == b[0]);
+}
+
+TEST_CASE("Move-only elements", "[deque]") {
+    Deque<std::unique_ptr<int>> a;
+    for (int i = 0; i < 300; ++i) {
+        a.PushBack(std::make_unique<int>(i));
+        a.EmplaceFront(new int(-i));
+    }
+    REQUIRE(*a[0] == -299);
+    REQUIRE(*a[599] == 299);
+}
+
+TEST_CASE("Blocks are reused", "[deque]") {
+    Deque<int, CountingAllocator<int>> a;
+    for (int i = 0; i < 128; ++i) {
+        a.PushBack(i);
+    }
+    allocations = 0;
+    for (int i = 0; i < 100000; ++i) {
+        a.PushBack(i);
+        a.PopBack();
+        a.PushFront(i);
+        a.PopFront();
+    }
+    REQUIRE(allocations <= 2u);
+
+    // A queue sliding through memory also keeps reusing the same blocks.
+    for (int i = 0; i < 100000; ++i) {
+        a.PushBack(i);
+        a.PopFront();
+    }
+    REQUIRE(allocations <= 4u);
+    REQUIRE(a.Size() == 128u);
+    REQUIRE(a[127] == 99999);
+}
+
+TEST_CASE("Move steals blocks", "[deque]") {
+    Deque<int> a;
+    for (int i = 0; i < 1000; ++i) {
+        a.PushBack(i);
+    }
+    int* first = &a[0];
+    Deque<int> b(std::move(a));
+    REQUIRE(&b[0] == first);
+    REQUIRE(a.Size() == 0u);
+    a.PushFront(7);
+    Check(a, std::vector<int>{7});
+
+    Deque<int> c{1, 2};
+    c = std::move(b);
+    REQUIRE(&c[0] == first);
+    REQUIRE(c.Size() == 1000u);
+    REQUIRE(c[999] == 999);
+}
+
+TEST_CASE("Bulk operations", "[deque]") {
+    std::vector<int> values(1000);
+    std::iota(values.begin(), values.end(), 0);
+    std::deque<int> expected;
+
+    Deque<int> a;
+    a.PushBack(-1);
+    expected.push_back(-1);
+    a.Append(values);
+    expected.insert(expected.end(), values.begin(), values.end());
+    a.Prepend(std::span(values).first(300));
+    expected.insert(expected.begin(), values.begin(), values.begin() + 300);
+    a.Prepend(std::span(values).subspan(10, 5));
+    expected.insert(expected.begin(), values.begin() + 10, values.begin() + 15);
+    REQUIRE(a.Size() == expected.size());
+    REQUIRE(std::equal(expected.begin(), expected.end(), a.Begin(), a.End()));
+
+    a.EraseFront(200);
+    expected.erase(expected.begin(), expected.begin() + 200);
+    a.EraseBack(777);
+    expected.erase(expected.end() - 777, expected.end());
+    REQUIRE(std::equal(expected.begin(), expected.end(), a.Begin(), a.End()));
+
+    a.Resize(500);
+    expected.resize(500);
+    REQUIRE(std::equal(expected.begin(), expected.end(), a.Begin(), a.End()));
+    a.Resize(10);
+    expected.resize(10);
+    REQUIRE(std::equal(expected.begin(), expected.end(), a.Begin(), a.End()));
+
+    a.EraseFront(10);
+    REQUIRE(a.Size() == 0u);
+    a.Prepend(values);
+    a.EraseBack(a.Size());
+    a.PushFront(4);
+    Check(a, std::vector<int>{4});
+}
+
+TEST_CASE("Bulk operations with non-trivial elements", "[deque]") {
+    std::vector<std::string> values;
+    for (int i = 0; i < 300; ++i) {
+        values.push_back(std::string(30, 'a' + i % 26));
+    }
+
+    Deque<std::string> a{"x"};
+    a.Prepend(values);
+    a.Append(values);
+    REQUIRE(a.Size() == 601u);
+    REQUIRE(a[0] == values[0]);
+    REQUIRE(a[299] == values[299]);
+    REQUIRE(a[300] == "x");
+    REQUIRE(a[600] == values[299]);
+
+    a.EraseFront(300);
+    a.EraseBack(299);
+    a.Resize(200);
+    REQUIRE(a[0] == "x");
+    REQUIRE(a[1] == values[0]);
+    REQUIRE(a[199].empty());
+
+    Deque<std::string> b(a);
+    REQUIRE(b.Size() == 200u);
+    REQUIRE(b[1] == values[0]);
+}
+
+TEST_CASE("Bulk append is exception safe", "[deque]") {
+    struct Thrower {
+        Thrower(int value) : value(value) {
+        }
+        Thrower(const Thrower& other) : value(other.value) {
+            if (value == 200) {
+                throw std::runtime_error("copy");
+            }
+        }
+
+        int value;
+    };
+
+    std::vector<Thrower> values;
+    values.reserve(300);
+    for (int i = 0; i < 300; ++i) {
+        values.emplace_back(i);
+    }
+    Deque<Thrower> a;
+    REQUIRE_THROWS_AS(a.Append(values), std::runtime_error);
+    REQUIRE(a.Size() == 128u);
+    REQUIRE(a[127].value == 127);
+    REQUIRE_THROWS_AS(a.Prepend(std::span(values).subspan(150)), std::runtime_error);
+    REQUIRE(a.Size() == 128u);
+    a.EmplaceFront(-1);
+    REQUIRE(a[0].value == -1);
+}
+
+TEST_CASE("Block size", "[deque]") {
+    static_assert(DequeBlock<int>::kSize == 128);
+    static_assert(DequeBlock<int, kPageSize>::kSize == 1024);
+    static_assert(DequeBlock<std::string, 16>::kSize == 1);
+    static_assert(sizeof(DequeBlock<int, kPageSize, kPageSize>) == kPageSize);
+    static_assert(alignof(DequeBlock<int, 256, kCacheLineSize>) == kCacheLineSize);
+
+    Deque<int, std::allocator<int>, kPageSize, kPageSize> a;
+    std::deque<int> b;
+    for (int i = 0; i < 10000; ++i) {
+        if (i % 3 == 0) {
+            a.PushFront(i);
+            b.push_front(i);
+        } else {
+            a.PushBack(i);
+            b.push_back(i);
+        }
+    }
+    REQUIRE(std::equal(b.begin(), b.end(), a.Begin(), a.End()));
+    a.Resize(3000);
+    a.Clear();
+    a.Resize(3000);
+    REQUIRE(reinterpret_cast<uintptr_t>(&a[0]) % kPageSize == 0);
+    REQUIRE(reinterpret_cast<uintptr_t>(&a[1024]) % kPageSize == 0);
+    REQUIRE(reinterpret_cast<uintptr_t>(&a[2048]) % kPageSize == 0);
+
+    Deque<int, std::allocator<int>, 256, kCacheLineSize> c(1000);
+    REQUIRE(reinterpret_cast<uintptr_t>(&c[0]) % kCacheLineSize == 0);
+    REQUIRE(reinterpret_cast<uintptr_t>(&c[64]) % kCacheLineSize == 0);
+    REQUIRE(&c[62] + 1 == &c[63]);
+
+    Deque<std::string, std::allocator<std::string>, 16> d{"a", "b"};
+    d.PushFront("c");
+    d.Append(std::vector<std::string>(5, "d"));
+    REQUIRE(d.Size() == 8u);
+    REQUIRE(d[0] == "c");
+    REQUIRE(d[7] == "d");
+}
+
+TEST_CASE("Shrink to fit", "[deque]") {
+    Deque<int> a;
+    const size_t empty = a.MemoryUsage();
+    a.Resize(1000000);
+    REQUIRE(a.capacity_ >= 1000000 / 128);
+    a.EraseBack(1000000 - 8 * 128);
+    a.ShrinkToFit();
+    REQUIRE(a.capacity_ == 8u);
+    REQUIRE(a.MemoryUsage() == empty + 8 * 3 * sizeof(size_t) + 8 * 512);
+    REQUIRE(a.Size() == 1024u);
+    a.PushFront(5);
+    a.PushBack(6);
+    REQUIRE(a[0] == 5);
+    REQUIRE(a[1025] == 6);
+
+    a.Clear();
+    a.ShrinkToFit();
+    REQUIRE(a.MemoryUsage() == empty);
+    a.PushBack(7);
+    Check(a, std::vector<int>{7});
+}
+
+TEST_CASE("Auto shrink", "[deque]") {
+    Deque<int, CountingAllocator<int>> a;
+    a.SetAutoShrink(true);
+    for (int i = 0; i < 1000000; ++i) {
+        a.PushBack(i);
+    }
+    const size_t peak = a.capacity_;
+    REQUIRE(peak == 8192u);
+    while (a.Size() > 10000) {
+        a.PopFront();
+    }
+    REQUIRE(a.capacity_ <= 512u);
+    REQUIRE(a.capacity_ >= 128u);
+    REQUIRE(a[0] == 990000);
+    REQUIRE(a[9999] == 999999);
+
+    // Crossing the growth threshold back and forth reallocates the map only once.
+    const size_t capacity = a.capacity_;
+    for (int i = 0; i < 1000; ++i) {
+        a.Resize(capacity * 128 + 1);
+        a.Resize(capacity / 2 * 128);
+        REQUIRE(a.capacity_ == 2 * capacity);
+    }
+
+    a.Clear();
+    REQUIRE(a.capacity_ == 64u);
+    a.SetAutoShrink(false);
+    a.Resize(1000000);
+    a.Clear();
+    REQUIRE(a.capacity_ == 8192u);
+
+    // Destroying a big deque frees its map without allocating a smaller one.
+    {
+        Deque<int, CountingAllocator<int>> b;
+        b.SetAutoShrink(true);
+        b.Resize(1000000);
+        allocations = 0;
+    }
+    REQUIRE(allocations == 0u);
+}
+
+static_assert(std::random_access_iterator<Deque<int>::Iterator>);
+static_assert(std::random_access_iterator<Deque<int>::ConstIterator>);
+
+TEST_CASE("Iterators", "[deque]") {
+    Deque<int> a;
+    std::vector<int> expected;
+    for (int i = 0; i < 1000; ++i) {
+        a.PushFront(-i);
+        a.PushBack(i);
+        expected.insert(expected.begin(), -i);
+        expected.push_back(i);
+    }
+
+    std::vector<int> copied(a.Size());
+    std::copy(a.Begin(), a.End(), copied.begin());
+    REQUIRE(copied == expected);
+
+    std::vector<int> reversed(std::make_reverse_iterator(a.End()),
+                              std::make_reverse_iterator(a.Begin()));
+    REQUIRE(std::equal(reversed.rbegin(), reversed.rend(), expected.begin()));
+
+    int sum = 0;
+    for (int x : a) {
+        sum += x;
+    }
+    REQUIRE(sum == std::accumulate(expected.begin(), expected.end(), 0));
+
+    auto it = a.Begin();
+    REQUIRE(a.End() - it == 2000);
+    it += 1500;
+    REQUIRE(*it == expected[1500]);
+    it -= 1400;
+    REQUIRE(*it == expected[100]);
+    REQUIRE(it[300] == expected[400]);
+    REQUIRE(*(it + 1000 - 1) == expected[1099]);
+    REQUIRE(it < a.End());
+    REQUIRE((it--)[0] == expected[100]);
+    REQUIRE(*it == expected[99]);
+
+    const Deque<int>& ca = a;
+    Deque<int>::ConstIterator cit = a.Begin();
+    REQUIRE(cit == ca.Begin());
+    REQUIRE(std::is_sorted(ca.Begin(), ca.End()));
+}
+
+TEST_CASE("Sort", "[deque]") {
+    std::mt19937 gen(735675);
+    Deque<int> a;
+    std::vector<int> b;
+    for (int i = 0; i < 100000; ++i) {
+        int value = gen();
+        if (i % 2) {
+            a.PushBack(value);
+        } else {
+            a.PushFront(value);
+        }
+    }
+    for (int x : a) {
+        b.push_back(x);
+    }
+    std::sort(a.Begin(), a.End());
+    std::sort(b.begin(), b.end());
+    REQUIRE(std::equal(b.begin(), b.end(), a.Begin(), a.End()));
+}
+
+TEST_CASE("SPSC queue", "[spsc]") {
+    SpscQueue<std::string> queue(200);
+    REQUIRE(queue.Capacity() == 256u);
+    std::string value;
+    REQUIRE(!queue.TryPop(&value));
+
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 0; i < 256; ++i) {
+            REQUIRE(queue.TryPush(std::to_string(i)));
+        }
+        REQUIRE(!queue.TryPush("overflow"));
+        for (int i = 0; i < 100; ++i) {
+            REQUIRE(queue.TryPop(&value));
+            REQUIRE(value == std::to_string(i));
+        }
+        std::vector<std::string> more(150, "x");
+        REQUIRE(queue.PushMany(more) == 100u);
+        std::vector<std::string> out(300);
+        REQUIRE(queue.PopMany(out) == 256u);
+        REQUIRE(out[0] == "100");
+        REQUIRE(out[155] == "255");
+        REQUIRE(out[156] == "x");
+        REQUIRE(queue.SizeApprox() == 0u);
+    }
+    // The rest is destroyed with the queue.
+    queue.TryEmplace(100, 'y');
+}
+
+TEST_CASE("SPSC queue bulk push is exception safe", "[spsc]") {
+    static int alive = 0;
+    struct Thrower {
+        Thrower(int value) : value(value) {
+            ++alive;
+        }
+        Thrower(const Thrower& other) : value(other.value) {
+            if (value == 200) {
+                throw std::runtime_error("copy");
+            }
+            ++alive;
+        }
+        Thrower& operator=(const Thrower&) = default;
+        ~Thrower() {
+            --alive;
+        }
+
+        int value;
+    };
+
+    std::vector<Thrower> values;
+    values.reserve(300);
+    for (int i = 0; i < 300; ++i) {
+        values.emplace_back(i);
+    }
+    {
+        SpscQueue<Thrower> queue(512);
+        // The copies before the throwing one span two blocks and are published.
+        REQUIRE_THROWS_AS(queue.PushMany(values), std::runtime_error);
+        REQUIRE(queue.SizeApprox() == 200u);
+        REQUIRE(alive == 500);
+        std::vector<Thrower> out(150, Thrower(-1));
+        REQUIRE(queue.PopMany(out) == 150u);
+        REQUIRE(out[149].value == 149);
+        REQUIRE(queue.SizeApprox() == 50u);
+    }
+    REQUIRE(alive == 300);
+}
+
+TEST_CASE("SPSC queue frees its blocks if construction fails", "[spsc]") {
+    using Queue = SpscQueue<int, CountingAllocator<int>>;
+    live_allocations = 0;
+    // The map and two blocks out of eight.
+    live_allocations_limit = 3;
+    REQUIRE_THROWS_AS(Queue(8 * 128), std::bad_alloc);
+    REQUIRE(live_allocations == 0u);
+    live_allocations_limit = SIZE_MAX;
+    {
+        Queue queue(8 * 128);
+        REQUIRE(live_allocations == 9u);
+    }
+    REQUIRE(live_allocations == 0u);
+}
+
+TEST_CASE("SPSC queue across threads", "[spsc]") {
+    const int kMessages = 1000000;
+    SpscQueue<int> queue(1000);
+
+    std::thread producer([&queue] {
+        int next = 0;
+        std::vector<int> batch(37);
+        while (next < kMessages) {
+            if (next % 2) {
+                next += queue.TryPush(next);
+            } else {
+                size_t count = std::min<size_t>(batch.size(), kMessages - next);
+                for (size_t i = 0; i < count; ++i) {
+                    batch[i] = next + i;
+                }
+                next += queue.PushMany(std::span(batch).first(count));
+            }
+            if (queue.SizeApprox() == queue.Capacity()) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    int expected = 0;
+    bool ordered = true;
+    std::vector<int> batch(53);
+    while (expected < kMessages) {
+        size_t count = queue.PopMany(batch);
+        for (size_t i = 0; i < count; ++i) {
+            ordered &= batch[i] == expected++;
+        }
+        int value;
+        if (queue.TryPop(&value)) {
+            ordered &= value == expected++;
+        } else if (count == 0) {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+    REQUIRE(ordered);
+    REQUIRE(queue.SizeApprox() == 0u);
+}
+
+TEST_CASE("Blocking queue", "[blocking]") {
+    using namespace std::chrono_literals;
+
+    BlockingQueue<std::string> queue(3);
+    REQUIRE(queue.Push("a"));
+    REQUIRE(queue.TryPush("b"));
+    REQUIRE(queue.TryPushFor("c", 1ms));
+    REQUIRE(queue.Size() == 3u);
+    REQUIRE_FALSE(queue.TryPush("d"));
+    REQUIRE_FALSE(queue.TryPushFor("d", 10ms));
+
+    std::string value;
+    REQUIRE(queue.TryPop(&value));
+    REQUIRE(value == "a");
+    REQUIRE(queue.Push("d"));
+    std::vector<std::string> batch(5);
+    REQUIRE(queue.PopMany(batch) == 3u);
+    REQUIRE(batch[0] == "b");
+    REQUIRE(batch[2] == "d");
+    REQUIRE_FALSE(queue.TryPop(&value));
+    REQUIRE_FALSE(queue.TryPopFor(&value, 10ms));
+    // An empty batch does not wait for the empty queue.
+    REQUIRE(queue.PopMany(std::span<std::string>()) == 0u);
+
+    REQUIRE(queue.Push("e"));
+    queue.Close();
+    REQUIRE_FALSE(queue.Push("f"));
+    REQUIRE(queue.Pop(&value));
+    REQUIRE(value == "e");
+    REQUIRE_FALSE(queue.Pop(&value));
+    REQUIRE(queue.PopMany(batch) == 0u);
+}
+
+TEST_CASE("Blocking queue wakes up waiters", "[blocking]") {
+    BlockingQueue<int> queue(1);
+    int popped[3] = {};
+    bool pops[3] = {};
+    std::thread consumer([&] {
+        for (int i = 0; i < 3; ++i) {
+            pops[i] = queue.Pop(&popped[i]);
+        }
+    });
+    REQUIRE(queue.Push(1));
+    REQUIRE(queue.Push(2));
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    queue.Close();
+    consumer.join();
+    REQUIRE(pops[0]);
+    REQUIRE(popped[0] == 1);
+    REQUIRE(pops[1]);
+    REQUIRE(popped[1] == 2);
+    REQUIRE_FALSE(pops[2]);
+
+    BlockingQueue<int> full(1);
+    REQUIRE(full.Push(0));
+    bool pushed = true;
+    std::thread producer([&] { pushed = full.Push(1); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    full.Close();
+    producer.join();
+    REQUIRE_FALSE(pushed);
+}
+
+TEST_CASE("Blocking queue with many producers and consumers", "[blocking]") {
+    const int kProducers = 4;
+    const int kConsumers = 3;
+    const int kMessages = 100000;
+    BlockingQueue<int> queue(64);
+
+    std::vector<std::thread> producers;
+    for (int i = 0; i < kProducers; ++i) {
+        producers.emplace_back([&queue, i] {
+            for (int j = 0; j < kMessages; ++j) {
+                queue.Push(i * kMessages + j);
+            }
+        });
+    }
+    std::atomic<int64_t> sum = 0;
+    std::atomic<int> count = 0;
+    std::vector<std::thread> consumers;
+    for (int i = 0; i < kConsumers; ++i) {
+        consumers.emplace_back([&queue, &sum, &count, i] {
+            std::vector<int> batch(16);
+            int64_t local_sum = 0;
+            int local_count = 0;
+            if (i % 2) {
+                while (size_t popped = queue.PopMany(batch)) {
+                    local_sum += std::accumulate(batch.begin(), batch.begin() + popped, int64_t{0});
+                    local_count += popped;
+                }
+            } else {
+                int value;
+                while (queue.Pop(&value)) {
+                    local_sum += value;
+                    ++local_count;
+                }
+            }
+            sum += local_sum;
+            count += local_count;
+        });
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    queue.Close();
+    for (auto& consumer : consumers) {
+        consumer.join();
+    }
+
+    const int64_t total = int64_t{kProducers} * kMessages;
+    REQUIRE(count == total);
+    REQUIRE(sum == total * (total - 1) / 2);
+}
+
+TEST_CASE("Work-stealing deque", "[work-stealing]") {
+    WorkStealingDeque<int> deque(2);
+    int value = 0;
+    REQUIRE(!deque.Pop(&value));
+    REQUIRE(!deque.Steal(&value));
+    for (int i = 0; i < 100; ++i) {
+        deque.Push(i);
+    }
+    REQUIRE(deque.Capacity() == 128u);
+    REQUIRE(deque.Steal(&value));
+    REQUIRE(value == 0);
+    REQUIRE(deque.Pop(&value));
+    REQUIRE(value == 99);
+    REQUIRE(deque.Size() == 98u);
+}
+
+TEST_CASE("Work-stealing deque with thieves", "[work-stealing]") {
+    const int kItems = 200000;
+    const int kThieves = 3;
+    WorkStealingDeque<int> deque(4);
+    std::atomic<bool> done = false;
+    std::atomic<int64_t> sum = 0;
+    std::atomic<int> taken = 0;
+
+    std::vector<std::thread> thieves;
+    for (int i = 0; i < kThieves; ++i) {
+        thieves.emplace_back([&] {
+            int value;
+            while (!done) {
+                if (deque.Steal(&value)) {
+                    sum += value;
+                    ++taken;
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    int value;
+    for (int i = 1; i <= kItems; ++i) {
+        deque.Push(i);
+        if (i % 3 == 0 && deque.Pop(&value)) {
+            sum += value;
+            ++taken;
+        }
+    }
+    while (deque.Pop(&value)) {
+        sum += value;
+        ++taken;
+    }
+    while (taken < kItems) {
+        std::this_thread::yield();
+    }
+    done = true;
+    for (auto& thread : thieves) {
+        thread.join();
+    }
+    REQUIRE(taken == kItems);
+    REQUIRE(sum == int64_t{kItems} * (kItems + 1) / 2);
+}
+
+namespace {
+
+int64_t ParallelFib(ForkJoinPool& pool, int n) {
+    if (n < 15) {
+        return n < 2 ? n : ParallelFib(pool, n - 1) + ParallelFib(pool, n - 2);
+    }
+    int64_t left = 0;
+    int64_t right = 0;
+    pool.Join([&] { left = ParallelFib(pool, n - 1); }, [&] { right = ParallelFib(pool, n - 2); });
+    return left + right;
+}
+
+}  // namespace
+
+TEST_CASE("Fork-join pool", "[work-stealing]") {
+    ForkJoinPool pool(4);
+    REQUIRE(pool.ThreadsCount() == 4u);
+
+    int64_t fib = 0;
+    pool.Run([&] { fib = ParallelFib(pool, 25); });
+    REQUIRE(fib == 75025);
+    // Join outside of the pool runs sequentially.
+    REQUIRE(ParallelFib(pool, 20) == 6765);
+
+    auto right_throws = [&] { pool.Join([] {}, [] { throw std::runtime_error("right"); }); };
+    REQUIRE_THROWS_AS(pool.Run(right_throws), std::runtime_error);
+    auto left_throws = [&] { pool.Join([] { throw std::logic_error("left"); }, [] {}); };
+    REQUIRE_THROWS_AS(pool.Run(left_throws), std::logic_error);
+
+    pool.Run([&] { fib = ParallelFib(pool, 22); });
+    REQUIRE(fib == 17711);
+
+    // Short tasks from several outside threads: each task lives on its caller's
+    // stack and is gone as soon as Run returns.
+    std::atomic<int> runs = 0;
+    std::vector<std::thread> callers;
+    for (int i = 0; i < 4; ++i) {
+        callers.emplace_back([&] {
+            for (int j = 0; j < 1000; ++j) {
+                pool.Run([&] { ++runs; });
+            }
+        });
+    }
+    for (auto& caller : callers) {
+        caller.join();
+    }
+    REQUIRE(runs == 4000);
+}
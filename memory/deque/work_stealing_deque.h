@@ -0,0 +1,141 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+// Chase-Lev work-stealing deque. The owner thread pushes and pops at the bottom,
+// any number of thieves steal from the top. Only the last element is contended,
+// and the owner takes a CAS only to race the thieves for it. Elements are copied
+// with single atomic loads and stores, so they are meant to be pointers or other
+// small trivially copyable values. Memory orders follow Le et al., "Correct and
+// Efficient Work-Stealing for Weak Memory Models".
+template <class T>
+class WorkStealingDeque {
+    static_assert(std::is_trivially_copyable_v<T>);
+
+public:
+    explicit WorkStealingDeque(size_t capacity = 64) {
+        size_t power = 1;
+        while (power < capacity) {
+            power *= 2;
+        }
+        array_.store(new Array(power), std::memory_order_relaxed);
+    }
+
+    ~WorkStealingDeque() {
+        Array* array = array_.load(std::memory_order_relaxed);
+        while (array) {
+            delete std::exchange(array, array->previous);
+        }
+    }
+
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+    // Owner only.
+    void Push(T value) {
+        int64_t bottom = bottom_.load(std::memory_order_relaxed);
+        int64_t top = top_.load(std::memory_order_acquire);
+        Array* array = array_.load(std::memory_order_relaxed);
+        if (bottom - top >= static_cast<int64_t>(array->capacity)) {
+            array = array->Grow(top, bottom);
+            array_.store(array, std::memory_order_release);
+        }
+        array->Put(bottom, value);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom_.store(bottom + 1, std::memory_order_relaxed);
+    }
+
+    // Owner only. Takes the most recently pushed element.
+    bool Pop(T* value) {
+        int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+        Array* array = array_.load(std::memory_order_relaxed);
+        bottom_.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t top = top_.load(std::memory_order_relaxed);
+        if (top > bottom) {
+            bottom_.store(bottom + 1, std::memory_order_relaxed);
+            return false;
+        }
+        *value = array->Get(bottom);
+        if (top == bottom) {
+            // The last element, a thief may be taking it right now.
+            bool won = top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                                    std::memory_order_relaxed);
+            bottom_.store(bottom + 1, std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    // Any thread. Takes the least recently pushed element, fails if the deque
+    // is empty or another thread took that element first.
+    bool Steal(T* value) {
+        int64_t top = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t bottom = bottom_.load(std::memory_order_acquire);
+        if (top >= bottom) {
+            return false;
+        }
+        T stolen = array_.load(std::memory_order_acquire)->Get(top);
+        if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                          std::memory_order_relaxed)) {
+            return false;
+        }
+        *value = stolen;
+        return true;
+    }
+
+    // Approximate unless called by the owner while nobody steals.
+    size_t Size() const {
+        int64_t bottom = bottom_.load(std::memory_order_relaxed);
+        int64_t top = top_.load(std::memory_order_relaxed);
+        return bottom > top ? bottom - top : 0;
+    }
+
+    size_t Capacity() const {
+        return array_.load(std::memory_order_relaxed)->capacity;
+    }
+
+private:
+    // Ring of atomics indexed by the ever growing top and bottom, like the
+    // block ring of Deque. It doubles when full, as Deque::Rebase does.
+    struct Array {
+        explicit Array(size_t capacity)
+            : capacity(capacity), items(std::make_unique<std::atomic<T>[]>(capacity)) {
+        }
+
+        // Relaxed would do given the fences around, but acquire and release are
+        // free on x86 and let thread sanitizer, which ignores fences, see that
+        // whatever an element points to was published together with it.
+        T Get(int64_t i) const {
+            return items[i & (capacity - 1)].load(std::memory_order_acquire);
+        }
+        void Put(int64_t i, T value) {
+            items[i & (capacity - 1)].store(value, std::memory_order_release);
+        }
+
+        // Thieves may still be reading this array, so it is kept
+        // linked from the new one until the deque is destroyed.
+        Array* Grow(int64_t top, int64_t bottom) {
+            Array* grown = new Array(capacity * 2);
+            for (int64_t i = top; i < bottom; ++i) {
+                grown->Put(i, Get(i));
+            }
+            grown->previous = this;
+            return grown;
+        }
+
+        size_t capacity;
+        std::unique_ptr<std::atomic<T>[]> items;
+        Array* previous = nullptr;
+    };
+
+    alignas(64) std::atomic<int64_t> top_ = 0;
+    alignas(64) std::atomic<int64_t> bottom_ = 0;
+    std::atomic<Array*> array_;
+};
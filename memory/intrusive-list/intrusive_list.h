@@ -169,6 +169,12 @@ public:
         dummy_.right_->Unlink();
     }
 
+    // Starts loading the neighbours that unlinking elem would write to.
+    static void PrefetchNeighbours(const T* elem) {
+        __builtin_prefetch(elem->left_, 1);
+        __builtin_prefetch(elem->right_, 1);
+    }
+
     Iterator Begin() {
         return Iterator(static_cast<T*>(dummy_.right_));
     }
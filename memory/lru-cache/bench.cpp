@@ -0,0 +1,361 @@
+#include <catch.hpp>
+#include <util.h>
+#include <cache_stats.h>
+#include <flat_index.h>
+#include <lru_cache.h>
+#include <sharded_lru_cache.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace {
+
+const size_t kCacheSize = 100000;
+const size_t kKeysCount = 200000;
+const size_t kOpsPerThread = 50000;
+
+std::vector<std::string> GenKeys() {
+    std::vector<std::string> keys;
+    keys.reserve(kKeysCount);
+    for (size_t i = 0; i < kKeysCount; ++i) {
+        keys.push_back("key_" + std::to_string(i));
+    }
+    return keys;
+}
+
+// Runs kOpsPerThread operations (80% Get, 20% Set) on every thread
+// and returns the total throughput in operations per second.
+template <class Get, class Set>
+double MeasureThroughput(size_t threads_count, const std::vector<std::string>& keys, Get get,
+                         Set set) {
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t t = 0; t < threads_count; ++t) {
+        threads.emplace_back([&, t] {
+            RandomGenerator random(t);
+            std::string value;
+            for (size_t i = 0; i < kOpsPerThread; ++i) {
+                const auto& key = keys[random.GenInt<uint32_t>() % keys.size()];
+                if (i % 5 == 0) {
+                    set(key, key);
+                } else {
+                    get(key, &value);
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return threads_count * kOpsPerThread / elapsed.count();
+}
+
+using Trace = std::vector<std::string>;
+
+// Keys drawn from a Zipf distribution over keys_count keys.
+Trace GenZipfTrace(size_t keys_count, size_t length, double skew, uint32_t seed) {
+    std::vector<double> cdf(keys_count);
+    double sum = 0;
+    for (size_t i = 0; i < keys_count; ++i) {
+        sum += 1 / std::pow(i + 1, skew);
+        cdf[i] = sum;
+    }
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> uniform(0, sum);
+    Trace trace;
+    trace.reserve(length);
+    for (size_t i = 0; i < length; ++i) {
+        size_t key = std::lower_bound(cdf.begin(), cdf.end(), uniform(gen)) - cdf.begin();
+        trace.push_back("key_" + std::to_string(key));
+    }
+    return trace;
+}
+
+// Zipf traffic with a long one-off scan in the middle, like a nightly export.
+Trace GenScanTrace(size_t keys_count, size_t length) {
+    Trace trace = GenZipfTrace(keys_count, length, 0.9, 1);
+    Trace scan;
+    for (size_t i = 0; i < length / 2; ++i) {
+        scan.push_back("scan_" + std::to_string(i));
+    }
+    trace.insert(trace.begin() + length / 2, scan.begin(), scan.end());
+    Trace tail = GenZipfTrace(keys_count, length / 2, 0.9, 2);
+    trace.insert(trace.end(), tail.begin(), tail.end());
+    return trace;
+}
+
+// Recorded traces, one key per line, are taken from the colon-separated
+// LRU_CACHE_TRACES list. Synthetic traces are used when it is not set.
+std::vector<std::pair<std::string, Trace>> LoadTraces() {
+    std::vector<std::pair<std::string, Trace>> traces;
+    if (const char* paths = std::getenv("LRU_CACHE_TRACES")) {
+        std::stringstream list(paths);
+        std::string path;
+        while (std::getline(list, path, ':')) {
+            std::ifstream file(path);
+            Trace trace;
+            std::string key;
+            while (std::getline(file, key)) {
+                trace.push_back(key);
+            }
+            traces.emplace_back(path, std::move(trace));
+        }
+        return traces;
+    }
+    traces.emplace_back("zipf 0.9", GenZipfTrace(100000, 1000000, 0.9, 1));
+    traces.emplace_back("zipf 0.9 + scan", GenScanTrace(100000, 1000000));
+    return traces;
+}
+
+// Replays the trace in read-through mode: every miss is followed by Set.
+double HitRatio(const Trace& trace, size_t capacity, EvictionPolicy policy) {
+    LruCacheOptions options;
+    options.capacity = capacity;
+    options.policy = policy;
+    LruCache cache(options);
+    std::string value;
+    size_t hits = 0;
+    for (const auto& key : trace) {
+        if (cache.Get(key, &value)) {
+            ++hits;
+        } else {
+            cache.Set(key, key);
+        }
+    }
+    return static_cast<double>(hits) / trace.size();
+}
+
+// Counts requested bytes only, malloc headers of map nodes come on top.
+size_t allocated_bytes = 0;
+
+template <class T>
+struct CountingAllocator {
+    using value_type = T;
+
+    CountingAllocator() = default;
+    template <class U>
+    CountingAllocator(const CountingAllocator<U>&) {
+    }
+
+    T* allocate(size_t n) {
+        allocated_bytes += n * sizeof(T);
+        return std::allocator<T>().allocate(n);
+    }
+    void deallocate(T* p, size_t n) {
+        allocated_bytes -= n * sizeof(T);
+        std::allocator<T>().deallocate(p, n);
+    }
+
+    bool operator==(const CountingAllocator&) const = default;
+};
+
+struct IndexItem {
+    uint64_t key;
+};
+
+template <class Lookup>
+double MeasureLookups(const std::vector<uint64_t>& probes, Lookup lookup) {
+    size_t found = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t key : probes) {
+        found += lookup(key);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    REQUIRE(found == probes.size());
+    return probes.size() / elapsed.count();
+}
+
+}  // namespace
+
+TEST_CASE("Get/Set throughput scaling", "[benchmark]") {
+    auto keys = GenKeys();
+    std::cout << "threads\tglobal mutex, Mops/s\tsharded, Mops/s\n";
+    for (size_t threads_count = 1; threads_count <= 32; threads_count *= 2) {
+        LruCache global(kCacheSize);
+        std::mutex mutex;
+        double global_ops = MeasureThroughput(
+            threads_count, keys,
+            [&](const std::string& key, std::string* value) {
+                std::lock_guard<std::mutex> lock(mutex);
+                return global.Get(key, value);
+            },
+            [&](const std::string& key, const std::string& value) {
+                std::lock_guard<std::mutex> lock(mutex);
+                global.Set(key, value);
+            });
+
+        ShardedLruCache sharded(kCacheSize, 64);
+        double sharded_ops = MeasureThroughput(
+            threads_count, keys,
+            [&](const std::string& key, std::string* value) { return sharded.Get(key, value); },
+            [&](const std::string& key, const std::string& value) { sharded.Set(key, value); });
+
+        std::cout << threads_count << "\t" << global_ops / 1e6 << "\t" << sharded_ops / 1e6
+                  << "\n";
+    }
+}
+
+TEST_CASE("Trace replay hit ratio", "[benchmark]") {
+    std::cout << "trace\tcapacity\tLRU hit ratio\tTinyLFU hit ratio\n";
+    for (const auto& [name, trace] : LoadTraces()) {
+        for (size_t capacity : {1000, 10000}) {
+            std::cout << name << "\t" << capacity << "\t"
+                      << HitRatio(trace, capacity, EvictionPolicy::kLru) << "\t"
+                      << HitRatio(trace, capacity, EvictionPolicy::kTinyLfu) << "\n";
+        }
+    }
+}
+
+TEST_CASE("Flat index against unordered_map", "[benchmark]") {
+    const size_t kEntries = 1000000;
+    const size_t kProbes = 10000000;
+
+    std::vector<IndexItem> items(kEntries);
+    RandomGenerator random;
+    for (auto& item : items) {
+        item.key = random.GenInt<uint64_t>();
+    }
+    std::vector<uint64_t> probes(kProbes);
+    for (auto& probe : probes) {
+        probe = items[random.GenInt<uint32_t>() % kEntries].key;
+    }
+    std::hash<uint64_t> hash;
+
+    allocated_bytes = 0;
+    std::unordered_map<uint64_t, IndexItem*, std::hash<uint64_t>, std::equal_to<>,
+                       CountingAllocator<std::pair<const uint64_t, IndexItem*>>>
+        map;
+    for (auto& item : items) {
+        map.emplace(item.key, &item);
+    }
+    double map_bytes = static_cast<double>(allocated_bytes) / kEntries;
+    double map_lookups = MeasureLookups(probes, [&map](uint64_t key) { return map.count(key); });
+
+    FlatIndex<IndexItem> index;
+    for (auto& item : items) {
+        index.Insert(hash(item.key), &item);
+    }
+    double index_bytes = static_cast<double>(index.MemoryUsage()) / kEntries;
+    double index_lookups = MeasureLookups(probes, [&index, &hash](uint64_t key) {
+        return index.Find(hash(key), [key](const IndexItem& item) { return item.key == key; }) !=
+               nullptr;
+    });
+
+    std::cout << "index\tMlookups/s\tbytes per entry\n";
+    std::cout << "unordered_map\t" << map_lookups / 1e6 << "\t" << map_bytes << "\n";
+    std::cout << "FlatIndex\t" << index_lookups / 1e6 << "\t" << index_bytes << "\n";
+}
+
+TEST_CASE("MultiGet against Get", "[benchmark]") {
+    const size_t kEntries = 1000000;
+    const size_t kBatch = 100;
+    const size_t kBatches = 50000;
+
+    LruCache<uint64_t, uint64_t> cache(kEntries);
+    RandomGenerator random;
+    std::vector<uint64_t> keys(kEntries);
+    for (auto& key : keys) {
+        key = random.GenInt<uint64_t>();
+        cache.Set(key, key);
+    }
+    std::vector<uint64_t> probes(kBatch * kBatches);
+    for (auto& probe : probes) {
+        probe = keys[random.GenInt<uint32_t>() % kEntries];
+    }
+
+    size_t hits = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t probe : probes) {
+        hits += cache.Get(probe) != nullptr;
+    }
+    std::chrono::duration<double, std::nano> single = std::chrono::steady_clock::now() - start;
+
+    std::vector<uint64_t*> values(kBatch);
+    start = std::chrono::steady_clock::now();
+    for (size_t begin = 0; begin < probes.size(); begin += kBatch) {
+        hits += cache.MultiGet(std::span(probes).subspan(begin, kBatch), values);
+    }
+    std::chrono::duration<double, std::nano> batched = std::chrono::steady_clock::now() - start;
+    REQUIRE(hits == 2 * probes.size());
+
+    std::cout << "Get, ns per key\tMultiGet of " << kBatch << ", ns per key\n";
+    std::cout << single.count() / probes.size() << "\t" << batched.count() / probes.size()
+              << "\n";
+}
+
+TEST_CASE("Snapshot save and load", "[benchmark]") {
+    const size_t kEntries = 1000000;
+    auto path = (std::filesystem::temp_directory_path() / "bench_lru_cache.snapshot").string();
+
+    LruCache cache(kEntries);
+    RandomGenerator random;
+    for (size_t i = 0; i < kEntries; ++i) {
+        cache.Set("key_" + std::to_string(i), random.GenString(100));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    REQUIRE(cache.SaveSnapshot(path));
+    std::chrono::duration<double> save = std::chrono::steady_clock::now() - start;
+
+    LruCache restored(kEntries);
+    start = std::chrono::steady_clock::now();
+    REQUIRE(restored.LoadSnapshot(path));
+    std::chrono::duration<double> load = std::chrono::steady_clock::now() - start;
+    REQUIRE(restored.Size() == kEntries);
+
+    std::cout << "entries\tMB\tsave, s\tload, s\n";
+    std::cout << kEntries << "\t" << std::filesystem::file_size(path) / 1e6 << "\t"
+              << save.count() << "\t" << load.count() << "\n";
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Statistics overhead", "[benchmark]") {
+    const size_t kEntries = 100000;
+    const size_t kOps = 10000000;
+
+    auto measure = [kEntries, kOps](auto& cache) {
+        for (uint64_t i = 0; i < kEntries; ++i) {
+            cache.Set(i, i);
+        }
+        RandomGenerator random;
+        uint64_t hits = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < kOps; ++i) {
+            uint64_t key = random.GenInt<uint32_t>() % (2 * kEntries);
+            if (cache.Get(key)) {
+                ++hits;
+            } else {
+                cache.Set(key, key);
+            }
+        }
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        REQUIRE(hits > 0);
+        return elapsed.count() / kOps;
+    };
+
+    LruCache<uint64_t, uint64_t> plain(kEntries);
+    LruCache<uint64_t, uint64_t, LruCacheHash<uint64_t>, CacheStats> counted(kEntries);
+    double plain_ns = measure(plain);
+    double counted_ns = measure(counted);
+    auto stats = counted.GetStats();
+
+    std::cout << "NoCacheStats, ns per op\tCacheStats, ns per op\tGet p50, ns\tGet p99, ns\n";
+    std::cout << plain_ns << "\t" << counted_ns << "\t" << stats.get_latency.Percentile(0.5).count()
+              << "\t" << stats.get_latency.Percentile(0.99).count() << "\n";
+}
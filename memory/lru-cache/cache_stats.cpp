@@ -0,0 +1,86 @@
+#include "cache_stats.h"
+
+#include <algorithm>
+#include <bit>
+
+int LatencyHistogram::BucketOf(std::chrono::nanoseconds latency) {
+    uint64_t ns = std::max<int64_t>(1, latency.count());
+    return std::min<int>(std::bit_width(ns) - 1, kBucketsCount - 1);
+}
+
+void LatencyHistogram::Record(std::chrono::nanoseconds latency) {
+    ++buckets_[BucketOf(latency)];
+}
+
+void LatencyHistogram::AddToBucket(int bucket, uint64_t count) {
+    buckets_[bucket] += count;
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram& other) {
+    for (int i = 0; i < kBucketsCount; ++i) {
+        buckets_[i] += other.buckets_[i];
+    }
+}
+
+uint64_t LatencyHistogram::Count() const {
+    uint64_t count = 0;
+    for (uint64_t bucket : buckets_) {
+        count += bucket;
+    }
+    return count;
+}
+
+uint64_t LatencyHistogram::BucketCount(int bucket) const {
+    return buckets_[bucket];
+}
+
+std::chrono::nanoseconds LatencyHistogram::Percentile(double q) const {
+    uint64_t count = Count();
+    if (count == 0) {
+        return std::chrono::nanoseconds::zero();
+    }
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(q * count + 0.5));
+    uint64_t seen = 0;
+    for (int i = 0; i < kBucketsCount; ++i) {
+        seen += buckets_[i];
+        if (seen >= rank) {
+            return std::chrono::nanoseconds(int64_t{1} << (i + 1));
+        }
+    }
+    return std::chrono::nanoseconds(int64_t{1} << kBucketsCount);
+}
+
+CacheStatsSnapshot& CacheStatsSnapshot::operator+=(const CacheStatsSnapshot& other) {
+    hits += other.hits;
+    misses += other.misses;
+    inserts += other.inserts;
+    updates += other.updates;
+    evictions += other.evictions;
+    evicted_bytes += other.evicted_bytes;
+    get_latency.Merge(other.get_latency);
+    set_latency.Merge(other.set_latency);
+    return *this;
+}
+
+void CacheStats::RecordGet(std::chrono::nanoseconds latency) {
+    Bump(&get_latency_[LatencyHistogram::BucketOf(latency)]);
+}
+
+void CacheStats::RecordSet(std::chrono::nanoseconds latency) {
+    Bump(&set_latency_[LatencyHistogram::BucketOf(latency)]);
+}
+
+CacheStatsSnapshot CacheStats::Snapshot() const {
+    CacheStatsSnapshot snapshot;
+    snapshot.hits = hits_.load(std::memory_order_relaxed);
+    snapshot.misses = misses_.load(std::memory_order_relaxed);
+    snapshot.inserts = inserts_.load(std::memory_order_relaxed);
+    snapshot.updates = updates_.load(std::memory_order_relaxed);
+    snapshot.evictions = evictions_.load(std::memory_order_relaxed);
+    snapshot.evicted_bytes = evicted_bytes_.load(std::memory_order_relaxed);
+    for (int i = 0; i < LatencyHistogram::kBucketsCount; ++i) {
+        snapshot.get_latency.AddToBucket(i, get_latency_[i].load(std::memory_order_relaxed));
+        snapshot.set_latency.AddToBucket(i, set_latency_[i].load(std::memory_order_relaxed));
+    }
+    return snapshot;
+}
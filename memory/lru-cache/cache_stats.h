@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Counts of latencies in power of two buckets: bucket i holds latencies
+// from 2^i up to 2^(i + 1) nanoseconds, the last one everything longer.
+class LatencyHistogram {
+public:
+    static const int kBucketsCount = 32;
+
+    static int BucketOf(std::chrono::nanoseconds latency);
+
+    void Record(std::chrono::nanoseconds latency);
+    void AddToBucket(int bucket, uint64_t count);
+    void Merge(const LatencyHistogram& other);
+
+    uint64_t Count() const;
+    uint64_t BucketCount(int bucket) const;
+    // Upper bound of the bucket the q-th quantile falls into, zero if empty.
+    std::chrono::nanoseconds Percentile(double q) const;
+
+private:
+    uint64_t buckets_[kBucketsCount] = {};
+};
+
+struct CacheStatsSnapshot {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t inserts = 0;
+    uint64_t updates = 0;
+    uint64_t evictions = 0;
+    uint64_t evicted_bytes = 0;
+    // Only every CacheStats::kLatencySampleRate-th Get and Set is timed.
+    LatencyHistogram get_latency;
+    LatencyHistogram set_latency;
+
+    CacheStatsSnapshot& operator+=(const CacheStatsSnapshot& other);
+};
+
+// Statistics policy of LruCache that counts everything. Updated by the thread that
+// owns the cache, while Snapshot() may be called from any thread at any time:
+// counters are atomics, but they are bumped with plain loads and stores, which cost
+// no more than ordinary increments and never lock the bus.
+class CacheStats {
+public:
+    static const uint64_t kLatencySampleRate = 64;
+
+    void OnHit() {
+        Bump(&hits_);
+    }
+    void OnMiss() {
+        Bump(&misses_);
+    }
+    void OnInsert() {
+        Bump(&inserts_);
+    }
+    void OnUpdate() {
+        Bump(&updates_);
+    }
+    void OnEviction(size_t weight) {
+        Bump(&evictions_);
+        Bump(&evicted_bytes_, weight);
+    }
+
+    // True for one operation out of kLatencySampleRate, which should then be timed.
+    bool SampleLatency() {
+        return ++operations_ % kLatencySampleRate == 0;
+    }
+    void RecordGet(std::chrono::nanoseconds latency);
+    void RecordSet(std::chrono::nanoseconds latency);
+
+    CacheStatsSnapshot Snapshot() const;
+
+private:
+    static void Bump(std::atomic<uint64_t>* counter, uint64_t delta = 1) {
+        counter->store(counter->load(std::memory_order_relaxed) + delta,
+                       std::memory_order_relaxed);
+    }
+
+    std::atomic<uint64_t> hits_ = 0;
+    std::atomic<uint64_t> misses_ = 0;
+    std::atomic<uint64_t> inserts_ = 0;
+    std::atomic<uint64_t> updates_ = 0;
+    std::atomic<uint64_t> evictions_ = 0;
+    std::atomic<uint64_t> evicted_bytes_ = 0;
+    uint64_t operations_ = 0;
+    std::atomic<uint64_t> get_latency_[LatencyHistogram::kBucketsCount] = {};
+    std::atomic<uint64_t> set_latency_[LatencyHistogram::kBucketsCount] = {};
+};
+
+// Default statistics policy, compiles down to nothing.
+class NoCacheStats {
+public:
+    void OnHit() {
+    }
+    void OnMiss() {
+    }
+    void OnInsert() {
+    }
+    void OnUpdate() {
+    }
+    void OnEviction(size_t) {
+    }
+
+    bool SampleLatency() {
+        return false;
+    }
+    void RecordGet(std::chrono::nanoseconds) {
+    }
+    void RecordSet(std::chrono::nanoseconds) {
+    }
+
+    CacheStatsSnapshot Snapshot() const {
+        return {};
+    }
+};
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Open-addressing hash index of pointers with Robin Hood probing.
+// Every slot keeps the full hash next to the pointer, so a probe compares
+// keys only when the hashes match and never touches items of other keys.
+// Erasing shifts the following slots back, so there are no tombstones.
+template <class T>
+class FlatIndex {
+public:
+    FlatIndex() : slots_(kMinSlotsCount) {
+    }
+
+    // Returns the item with this hash for which is_equal(item) holds, or nullptr.
+    template <class IsEqual>
+    T* Find(size_t hash, IsEqual is_equal) const {
+        uint64_t h = Mix(hash);
+        size_t mask = slots_.size() - 1;
+        for (size_t pos = h & mask, distance = 0;; pos = (pos + 1) & mask, ++distance) {
+            const Slot& slot = slots_[pos];
+            if (slot.hash == kEmpty || DistanceOf(slot.hash, pos) < distance) {
+                return nullptr;
+            }
+            if (slot.hash == h && is_equal(*slot.item)) {
+                return slot.item;
+            }
+        }
+    }
+
+    // Starts loading the first slot probed for this hash into the cache.
+    void Prefetch(size_t hash) const {
+        __builtin_prefetch(&slots_[Mix(hash) & (slots_.size() - 1)]);
+    }
+
+    // Starts loading the item Find is most likely to compare first: the first one
+    // stored with the same full hash. Touches only the slots, never the items.
+    void PrefetchItem(size_t hash) const {
+        uint64_t h = Mix(hash);
+        size_t mask = slots_.size() - 1;
+        for (size_t pos = h & mask, distance = 0;; pos = (pos + 1) & mask, ++distance) {
+            const Slot& slot = slots_[pos];
+            if (slot.hash == kEmpty || DistanceOf(slot.hash, pos) < distance) {
+                return;
+            }
+            if (slot.hash == h) {
+                __builtin_prefetch(slot.item);
+                return;
+            }
+        }
+    }
+
+    // The item must not be in the index yet.
+    void Insert(size_t hash, T* item) {
+        if ((size_ + 1) * kMaxLoadDenominator > slots_.size() * kMaxLoadNumerator) {
+            Rehash(slots_.size() * 2);
+        }
+        Place(Slot{Mix(hash), item});
+        ++size_;
+    }
+
+    // The item must be in the index under this hash.
+    void Erase(size_t hash, const T* item) {
+        uint64_t h = Mix(hash);
+        size_t mask = slots_.size() - 1;
+        size_t pos = h & mask;
+        while (slots_[pos].item != item) {
+            pos = (pos + 1) & mask;
+        }
+        for (size_t next = (pos + 1) & mask;; pos = next, next = (next + 1) & mask) {
+            const Slot& slot = slots_[next];
+            if (slot.hash == kEmpty || DistanceOf(slot.hash, next) == 0) {
+                break;
+            }
+            slots_[pos] = slot;
+        }
+        slots_[pos] = Slot();
+        --size_;
+    }
+
+    // Grows the table ahead of time to hold count items without rehashing.
+    void Reserve(size_t count) {
+        size_t slots_count = slots_.size();
+        while (count * kMaxLoadDenominator > slots_count * kMaxLoadNumerator) {
+            slots_count *= 2;
+        }
+        if (slots_count != slots_.size()) {
+            Rehash(slots_count);
+        }
+    }
+
+    size_t Size() const {
+        return size_;
+    }
+
+    // Slots are numbered from zero to SlotsCount() - 1, At() is nullptr for empty ones.
+    size_t SlotsCount() const {
+        return slots_.size();
+    }
+    T* At(size_t slot) const {
+        return slots_[slot].item;
+    }
+
+    size_t MemoryUsage() const {
+        return sizeof(*this) + slots_.capacity() * sizeof(Slot);
+    }
+
+private:
+    static const uint64_t kEmpty = 0;
+    static const size_t kMinSlotsCount = 16;
+    // Robin Hood probing keeps probe sequences short up to a load of about 0.9.
+    static const size_t kMaxLoadNumerator = 7;
+    static const size_t kMaxLoadDenominator = 8;
+
+    struct Slot {
+        uint64_t hash = kEmpty;
+        T* item = nullptr;
+    };
+
+    // std::hash of integers is the identity, so low bits need mixing
+    // before they can pick a slot. Zero is reserved for empty slots.
+    static uint64_t Mix(size_t hash) {
+        uint64_t h = hash;
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+        return h == kEmpty ? 1 : h;
+    }
+
+    size_t DistanceOf(uint64_t hash, size_t pos) const {
+        return (pos - hash) & (slots_.size() - 1);
+    }
+
+    void Place(Slot slot) {
+        size_t mask = slots_.size() - 1;
+        for (size_t pos = slot.hash & mask, distance = 0;; pos = (pos + 1) & mask, ++distance) {
+            Slot& current = slots_[pos];
+            if (current.hash == kEmpty) {
+                current = slot;
+                return;
+            }
+            size_t current_distance = DistanceOf(current.hash, pos);
+            if (current_distance < distance) {
+                std::swap(current, slot);
+                distance = current_distance;
+            }
+        }
+    }
+
+    void Rehash(size_t slots_count) {
+        std::vector<Slot> old(slots_count);
+        old.swap(slots_);
+        for (const Slot& slot : old) {
+            if (slot.hash != kEmpty) {
+                Place(slot);
+            }
+        }
+    }
+
+    std::vector<Slot> slots_;
+    size_t size_ = 0;
+};
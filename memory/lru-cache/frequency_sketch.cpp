@@ -0,0 +1,71 @@
+#include "frequency_sketch.h"
+
+#include <algorithm>
+#include <bit>
+
+namespace {
+
+const uint64_t kSeeds[] = {0xc3a5c85c97cb3127ull, 0xb492b66fbe98f273ull, 0x9ae16a3b2f90404full,
+                           0xcbf29ce484222325ull};
+
+// Every word holds 16 counters of 4 bits, one word per expected entry.
+const size_t kCountersPerWord = 16;
+const size_t kMinWords = 8;
+const size_t kMaxWords = size_t{1} << 26;
+
+}  // namespace
+
+FrequencySketch::FrequencySketch(size_t expected_entries) {
+    EnsureCapacity(expected_entries);
+}
+
+void FrequencySketch::EnsureCapacity(size_t expected_entries) {
+    size_t words = std::bit_ceil(std::clamp(expected_entries, kMinWords, kMaxWords));
+    if (words <= table_.size()) {
+        return;
+    }
+    table_.assign(words, 0);
+    counters_mask_ = words * kCountersPerWord - 1;
+    additions_ = 0;
+    sample_size_ = 10 * words;
+}
+
+void FrequencySketch::Increment(uint64_t hash) {
+    bool added = false;
+    for (int row = 0; row < kDepth; ++row) {
+        size_t index = IndexOf(hash, row);
+        uint64_t& word = table_[index / kCountersPerWord];
+        int shift = (index % kCountersPerWord) * 4;
+        if (((word >> shift) & 0xf) < kMaxCount) {
+            word += uint64_t{1} << shift;
+            added = true;
+        }
+    }
+    if (added && ++additions_ == sample_size_) {
+        Age();
+    }
+}
+
+int FrequencySketch::Frequency(uint64_t hash) const {
+    int frequency = kMaxCount;
+    for (int row = 0; row < kDepth; ++row) {
+        size_t index = IndexOf(hash, row);
+        uint64_t word = table_[index / kCountersPerWord];
+        int shift = (index % kCountersPerWord) * 4;
+        frequency = std::min(frequency, static_cast<int>((word >> shift) & 0xf));
+    }
+    return frequency;
+}
+
+size_t FrequencySketch::IndexOf(uint64_t hash, int row) const {
+    uint64_t x = (hash + kSeeds[row]) * kSeeds[row];
+    x ^= x >> 32;
+    return x & counters_mask_;
+}
+
+void FrequencySketch::Age() {
+    for (auto& word : table_) {
+        word = (word >> 1) & 0x7777777777777777ull;
+    }
+    additions_ /= 2;
+}
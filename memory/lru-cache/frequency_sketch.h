@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Count-min sketch of 4-bit counters estimating how often a key hash was seen.
+// Counters are halved periodically, so the estimate favors recent history.
+class FrequencySketch {
+public:
+    explicit FrequencySketch(size_t expected_entries = 0);
+
+    // Grows the table if it is too small for that many distinct keys.
+    // Growing forgets all collected frequencies.
+    void EnsureCapacity(size_t expected_entries);
+
+    void Increment(uint64_t hash);
+
+    // Never less than the true count since the last aging, capped at 15.
+    int Frequency(uint64_t hash) const;
+
+private:
+    static const int kDepth = 4;
+    static const int kMaxCount = 15;
+
+    size_t IndexOf(uint64_t hash, int row) const;
+    void Age();
+
+    std::vector<uint64_t> table_;
+    size_t counters_mask_ = 0;
+    size_t additions_ = 0;
+    size_t sample_size_ = 0;
+};
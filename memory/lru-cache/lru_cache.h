@@ -1,21 +1,729 @@
 #pragma once
 
+#include "../intrusive-list/intrusive_list.h"
+#include "cache_stats.h"
+#include "flat_index.h"
+#include "frequency_sketch.h"
+#include "snapshot.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <optional>
+#include <span>
+#include <stdexcept>
 #include <string>
-#include <unordered_map>
-#include <list>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+enum class CapacityUnit { kEntries, kBytes };
+
+enum class EvictionPolicy {
+    kLru,
+    // W-TinyLFU: new entries go to a small LRU window; entries leaving the window
+    // are admitted to a segmented LRU main region only if the frequency sketch
+    // says they are more popular than the main region's victim.
+    kTinyLfu,
+};
+
+template <class K = std::string, class V = std::string>
+struct LruCacheOptions {
+    size_t capacity = 0;
+    CapacityUnit unit = CapacityUnit::kEntries;
+    // Size of an entry in bytes. When empty, strings weigh their size
+    // and any other type weighs its sizeof.
+    std::function<size_t(const K& key, const V& value)> weigher;
+    EvictionPolicy policy = EvictionPolicy::kLru;
+    // Time to live of entries set without an explicit one, zero means forever.
+    std::chrono::steady_clock::duration default_ttl{};
+    // Source of the current time, steady_clock::now when empty.
+    std::function<std::chrono::steady_clock::time_point()> clock;
+};
+
+template <class K>
+struct LruCacheHash : public std::hash<K> {};
+
+// Transparent, so that string keys can be looked up by std::string_view or const char*.
+template <>
+struct LruCacheHash<std::string> {
+    using is_transparent = void;
+    size_t operator()(std::string_view s) const {
+        return std::hash<std::string_view>{}(s);
+    }
+};
 
+// Stats is CacheStats to count hits, misses, evictions and sampled latencies,
+// or NoCacheStats to compile all of that out.
+template <class K = std::string, class V = std::string, class Hash = LruCacheHash<K>,
+          class Stats = NoCacheStats>
 class LruCache {
 public:
+    using Clock = std::chrono::steady_clock;
+
     LruCache(size_t max_size);
+    explicit LruCache(LruCacheOptions<K, V> options);
+
+    ~LruCache();
+
+    LruCache(const LruCache&) = delete;
+    LruCache& operator=(const LruCache&) = delete;
+
+    // Both key and value are moved in when passed as rvalues. Key may be of any
+    // type Hash and K can be compared with, value of any type V is assignable from.
+    template <class Key, class Value>
+    void Set(Key&& key, Value&& value);
+    // Zero ttl means the entry never expires.
+    template <class Key, class Value>
+    void Set(Key&& key, Value&& value, Clock::duration ttl);
+
+    // Constructs the value in place from args, replacing the old one if any, so V
+    // need not be movable. args may refer to the old value. If the constructor
+    // throws, the cache is left unchanged.
+    template <class Key, class... Args>
+    void Emplace(Key&& key, Args&&... args);
+
+    // Returns nullptr on a miss. The pointer stays valid until the next call
+    // that modifies the cache, Get included. Expired entries are reported as
+    // missing and reclaimed.
+    template <class Key>
+    V* Get(const Key& key);
+
+    template <class Key>
+    bool Get(const Key& key, V* value);
+
+    // Batched Get: hashes all keys and prefetches their index slots, then their
+    // entries, before resolving any of them, so that memory stalls of different
+    // keys overlap.
+    // values[i] gets what Get(keys[i]) would return. Returns the number of hits.
+    // Expiry is checked against one reading of the clock for the whole batch, so
+    // all the pointers stay valid until the next call that modifies the cache.
+    // Throws std::invalid_argument if values is shorter than keys.
+    size_t MultiGet(std::span<const K> keys, std::span<V*> values);
+    template <class Key>
+    size_t MultiGet(std::span<const Key> keys, std::span<V*> values);
 
-    void Set(const std::string& key, const std::string& value);
+    // Batched Set of keys[i] to values[i] with the same prefetching as MultiGet.
+    // Throws std::invalid_argument if values is shorter than keys.
+    void MultiSet(std::span<const K> keys, std::span<const V> values);
+    template <class Key, class Value>
+    void MultiSet(std::span<const Key> keys, std::span<const Value> values);
 
-    bool Get(const std::string& key, std::string* value);
+    // Removes expired entries, visiting the table incrementally from where the
+    // previous call stopped. Returns after time_slice or after a full pass,
+    // whichever comes first, and reports the number of removed entries.
+    size_t SweepExpired(Clock::duration time_slice);
+
+    // Writes all live entries to path, least recently used first, along with the
+    // time they have left to live. Keys and values are stored by SnapshotCodec.
+    // Entries whose key or value encodes to more than 4 GB are skipped. The old
+    // file is replaced only once the new one is complete. Returns false on I/O errors.
+    bool SaveSnapshot(const std::string& path);
+
+    // Sets all entries of a snapshot in the order they were saved, so that their
+    // recency is restored. The file is mapped rather than read, and entries are
+    // decoded straight from the mapping. Returns false if the file is missing or
+    // malformed, entries before the malformed one are kept.
+    bool LoadSnapshot(const std::string& path);
+
+    size_t Size() const;
+    // Total weight of all entries, whatever unit the capacity is measured in.
+    size_t Bytes() const;
+    size_t Evictions() const;
+    size_t Expirations() const;
+    // All zeros with NoCacheStats. Safe to call from any thread, while the
+    // cache is in use, in which case counters may lag behind a little.
+    CacheStatsSnapshot GetStats() const;
 
 private:
-    size_t max_size_ = 0;
-    std::unordered_map<std::string, std::list<std::pair<std::string, std::string> >::iterator>
-        data_;
-    std::list<std::pair<std::string, std::string> > list_;
-    void AddValueToEnd(const std::string& key);
+    // With kLru every entry stays in the window, which takes the whole capacity.
+    enum Region { kWindow, kProbation, kProtected, kRegionsCount };
+
+    // Allocated once per key, so it never moves and can be relinked in O(1).
+    struct Entry : public ListHook {
+        template <class Key, class... Args>
+        explicit Entry(Key&& key, Args&&... args)
+            : key(std::forward<Key>(key)), value(std::forward<Args>(args)...) {
+        }
+
+        K key;
+        V value;
+        size_t weight = 0;
+        size_t hash = 0;
+        Region region = kWindow;
+        Clock::time_point expires_at = Clock::time_point::max();
+    };
+
+    struct Segment {
+        // Most recently used entry is at the front.
+        List<Entry> list;
+        size_t used = 0;
+        size_t capacity = 0;
+    };
+
+    // Keys are resolved in groups of this size by MultiGet and MultiSet,
+    // enough to hide memory latency without evicting the prefetched lines.
+    static const size_t kBatchSize = 16;
+
+    template <class Key>
+    Entry* Find(const Key& key, size_t hash) const;
+    // now, if given, replaces the clock in the expiry check.
+    template <class Key>
+    V* GetHashed(const Key& key, size_t hash,
+                 std::optional<Clock::time_point> now = std::nullopt);
+    template <class Key, class Value>
+    void SetHashed(Key&& key, size_t hash, Value&& value, Clock::duration ttl);
+    template <class Key, class... Args>
+    Entry* Insert(Key&& key, size_t hash, Args&&... args);
+    // Recounts the weight of a freshly written entry and applies ttl to it.
+    void Commit(Entry* entry, Clock::duration ttl);
+
+    Clock::time_point Now() const;
+    bool IsExpired(const Entry& entry, std::optional<Clock::time_point> now) const;
+    size_t Weigh(const K& key, const V& value) const;
+    // Part of the capacity taken by an entry of the given weight.
+    size_t ChargeOf(size_t weight) const;
+    void Link(Entry* entry, Region region);
+    void Unlink(Entry* entry);
+    void Touch(Entry* entry);
+    void Erase(Entry* entry);
+    void Evict(Entry* entry);
+    void EvictIfNeeded();
+    void Admit(Entry* candidate);
+
+    LruCacheOptions<K, V> options_;
+    size_t bytes_ = 0;
+    size_t evictions_ = 0;
+    size_t expirations_ = 0;
+    // Number of entries with a finite time to live.
+    size_t expiring_ = 0;
+    size_t sweep_slot_ = 0;
+    Segment segments_[kRegionsCount];
+    FrequencySketch sketch_;
+    Hash hash_;
+    FlatIndex<Entry> index_;
+    Stats stats_;
 };
+
+template <class K, class V, class Hash, class Stats>
+LruCache<K, V, Hash, Stats>::LruCache(size_t max_size) {
+    options_.capacity = max_size;
+    segments_[kWindow].capacity = max_size;
+}
+
+template <class K, class V, class Hash, class Stats>
+LruCache<K, V, Hash, Stats>::LruCache(LruCacheOptions<K, V> options)
+    : options_(std::move(options)) {
+    size_t capacity = options_.capacity;
+    if (options_.policy == EvictionPolicy::kLru) {
+        segments_[kWindow].capacity = capacity;
+        return;
+    }
+    // 1% window, the rest is main: 20% probation and 80% protected.
+    size_t window = capacity > 0 ? std::max<size_t>(1, capacity / 100) : 0;
+    segments_[kWindow].capacity = window;
+    segments_[kProtected].capacity = (capacity - window) * 4 / 5;
+    segments_[kProbation].capacity = capacity - window - segments_[kProtected].capacity;
+    if (options_.unit == CapacityUnit::kEntries) {
+        sketch_.EnsureCapacity(capacity);
+    }
+}
+
+template <class K, class V, class Hash, class Stats>
+LruCache<K, V, Hash, Stats>::~LruCache() {
+    for (size_t slot = 0; slot < index_.SlotsCount(); ++slot) {
+        delete index_.At(slot);
+    }
+}
+
+template <class K, class V, class Hash, class Stats>
+template <class Key, class Value>
+void LruCache<K, V, Hash, Stats>::Set(Key&& key, Value&& value) {
+    Set(std::forward<Key>(key), std::forward<Value>(value), options_.default_ttl);
+}
+
+template <class K, class V, class Hash, class Stats>
+template <class Key, class Value>
+void LruCache<K, V, Hash, Stats>::Set(Key&& key, Value&& value, Clock::duration ttl) {
+    if (stats_.SampleLatency()) {
+        auto start = Clock::now();
+        size_t hash = hash_(key);
+        SetHashed(std::forward<Key>(key), hash, std::forward<Value>(value), ttl);
+        stats_.RecordSet(Clock::now() - start);
+        return;
+    }
+    size_t hash = hash_(key);
+    SetHashed(std::forward<Key>(key), hash, std::forward<Value>(value), ttl);
+}
+
+template <class K, class V, class Hash, class Stats>
+template <class Key, class... Args>
+void LruCache<K, V, Hash, Stats>::Emplace(Key&& key, Args&&... args) {
+    size_t hash = hash_(key);
+    Entry* entry = Find(key, hash);
+    if (entry) {
+        // The value is built in a new entry before the old one goes away, since
+        // args may refer to the old value.
+        auto* fresh = new Entry(std::forward<Key>(key), std::forward<Args>(args)...);
+        fresh->hash = hash;
+        stats_.OnUpdate();
+        Touch(entry);
+        Region region = entry->region;
+        Erase(entry);
+        index_.Insert(hash, fresh);
+        Link(fresh, region);
+        entry = fresh;
+    } else {
+        entry = Insert(std::forward<Key>(key), hash, std::forward<Args>(args)...);
+    }
+    Commit(entry, options_.default_ttl);
+}
+
+template <class K, class V, class Hash, class Stats>
+template <class Key>
+V* LruCache<K, V, Hash, Stats>::Get(const Key& key) {
+    if (stats_.SampleLatency()) {
+        auto start = Clock::now();
+        V* value = GetHashed(key, hash_(key));
+        stats_.RecordGet(Clock::now() - start);
+        return value;
+    }
+    return GetHashed(key, hash_(key));
+}
+
+template <class K, class V, class Hash, class Stats>
+template <class Key>
+bool LruCache<K, V, Hash, Stats>::Get(const Key& key, V* value) {
+    V* found = Get(key);
+    if (!found) {
+        return false;
+    }
+    *value = *found;
+    return true;
+}
+
+template <class K, class V, class Hash, class Stats>
+size_t LruCache<K, V, Hash, Stats>::MultiGet(std::span<const K> keys, std::span<V*> values) {
+    return MultiGet<K>(keys, values);
+}
+
+template <class K, class V, class Hash, class Stats>
+template <class Key>
+size_t LruCache<K, V, Hash, Stats>::MultiGet(std::span<const Key> keys, std::span<V*> values) {
+    if (values.size() < keys.size()) {
+        throw std::invalid_argument("LruCache::MultiGet: fewer values than keys");
+    }
+    // A repeated key whose entry expired mid-batch would erase the entry an
+    // earlier position already points to.
+    auto now = Now();
+    size_t hits = 0;
+    size_t hashes[kBatchSize];
+    for (size_t begin = 0; begin < keys.size(); begin += kBatchSize) {
+        size_t end = std::min(keys.size(), begin + kBatchSize);
+        for (size_t i = begin; i < end; ++i) {
+            hashes[i - begin] = hash_(keys[i]);
+            index_.Prefetch(hashes[i - begin]);
+        }
+        for (size_t i = begin; i < end; ++i) {
+            index_.PrefetchItem(hashes[i - begin]);
+        }
+        // A hit relinks the entry, which writes to both of its neighbours.
+        // Pointers are not kept, Get of an earlier duplicate key may erase the entry.
+        for (size_t i = begin; i < end; ++i) {
+            if (Entry* entry = Find(keys[i], hashes[i - begin])) {
+                List<Entry>::PrefetchNeighbours(entry);
+            }
+        }
+        for (size_t i = begin; i < end; ++i) {
+            values[i] = GetHashed(keys[i], hashes[i - begin], now);
+            hits += values[i] != nullptr;
+        }
+    }
+    return hits;
+}
+
+template <class K, class V, class Hash, class Stats>
+void LruCache<K, V, Hash, Stats>::MultiSet(std::span<const K> keys, std::span<const V> values) {
+    MultiSet<K, V>(keys, values);
+}
+
+template <class K, class V, class Hash, class Stats>
+template <class Key, class Value>
+void LruCache<K, V, Hash, Stats>::MultiSet(std::span<const Key> keys,
+                                           std::span<const Value> values) {
+    if (values.size() < keys.size()) {
+        throw std::invalid_argument("LruCache::MultiSet: fewer values than keys");
+    }
+    size_t hashes[kBatchSize];
+    for (size_t begin = 0; begin < keys.size(); begin += kBatchSize) {
+        size_t end = std::min(keys.size(), begin + kBatchSize);
+        for (size_t i = begin; i < end; ++i) {
+            hashes[i - begin] = hash_(keys[i]);
+            index_.Prefetch(hashes[i - begin]);
+        }
+        for (size_t i = begin; i < end; ++i) {
+            index_.PrefetchItem(hashes[i - begin]);
+        }
+        for (size_t i = begin; i < end; ++i) {
+            SetHashed(keys[i], hashes[i - begin], values[i], options_.default_ttl);
+        }
+    }
+}
+
+template <class K, class V, class Hash, class Stats>
+size_t LruCache<K, V, Hash, Stats>::SweepExpired(Clock::duration time_slice) {
+    // Checking the clock is not free, so it is done once per this many steps.
+    const size_t kStepsBetweenClockChecks = 64;
+
+    auto now = Now();
+    auto deadline = now + time_slice;
+    size_t removed = 0;
+    size_t visited = 0;
+    for (size_t slots = 0; expiring_ > 0 && slots < index_.SlotsCount();) {
+        Entry* entry = index_.At(sweep_slot_ % index_.SlotsCount());
+        if (entry && entry->expires_at <= now) {
+            // Erasing may shift the next slot into this one, so the cursor stays.
+            ++expirations_;
+            ++removed;
+            Erase(entry);
+        } else {
+            sweep_slot_ = (sweep_slot_ + 1) % index_.SlotsCount();
+            ++slots;
+        }
+        if (++visited == kStepsBetweenClockChecks) {
+            visited = 0;
+            now = Now();
+            if (now >= deadline) {
+                break;
+            }
+        }
+    }
+    return removed;
+}
+
+template <class K, class V, class Hash, class Stats>
+bool LruCache<K, V, Hash, Stats>::SaveSnapshot(const std::string& path) {
+    // Lists keep the most recent entry at the front, and the main region holds
+    // entries that outlived the window, so everything is gathered newest first.
+    auto now = Now();
+    std::vector<const Entry*> entries;
+    entries.reserve(Size());
+    for (Region region : {kWindow, kProtected, kProbation}) {
+        for (const Entry& entry : segments_[region].list) {
+            // Record sizes are 32-bit, larger entries are left out of the snapshot.
+            if (entry.expires_at > now && SnapshotCodec<K>::Size(entry.key) <= UINT32_MAX &&
+                SnapshotCodec<V>::Size(entry.value) <= UINT32_MAX) {
+                entries.push_back(&entry);
+            }
+        }
+    }
+
+    SnapshotWriter writer(path);
+    SnapshotHeader header;
+    std::memcpy(header.magic, kSnapshotMagic, sizeof(header.magic));
+    header.version = kSnapshotVersion;
+    header.count = entries.size();
+    writer.Write(&header, sizeof(header));
+    for (auto it = entries.rbegin(); it != entries.rend(); ++it) {
+        const Entry& entry = **it;
+        SnapshotRecord record;
+        record.key_size = static_cast<uint32_t>(SnapshotCodec<K>::Size(entry.key));
+        record.value_size = static_cast<uint32_t>(SnapshotCodec<V>::Size(entry.value));
+        record.ttl = 0;
+        if (entry.expires_at != Clock::time_point::max()) {
+            // At least a nanosecond, zero would make the entry immortal.
+            record.ttl = std::max<int64_t>(
+                1, std::chrono::duration_cast<std::chrono::nanoseconds>(entry.expires_at - now)
+                       .count());
+        }
+        writer.Write(&record, sizeof(record));
+        writer.Write(SnapshotCodec<K>::Data(entry.key), record.key_size);
+        writer.Write(SnapshotCodec<V>::Data(entry.value), record.value_size);
+    }
+    return writer.Commit();
+}
+
+template <class K, class V, class Hash, class Stats>
+bool LruCache<K, V, Hash, Stats>::LoadSnapshot(const std::string& path) {
+    MappedFile file(path);
+    const char* data = file.Data();
+    size_t size = file.Size();
+    SnapshotHeader header;
+    if (!data || size < sizeof(header)) {
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, kSnapshotMagic, sizeof(header.magic)) != 0 ||
+        header.version != kSnapshotVersion) {
+        return false;
+    }
+    // Records are at least this long, which bounds the count a corrupted header can claim.
+    index_.Reserve(Size() + std::min<uint64_t>(header.count, size / sizeof(SnapshotRecord)));
+
+    size_t offset = sizeof(header);
+    for (uint64_t i = 0; i < header.count; ++i) {
+        SnapshotRecord record;
+        if (size - offset < sizeof(record)) {
+            return false;
+        }
+        std::memcpy(&record, data + offset, sizeof(record));
+        offset += sizeof(record);
+        if (size - offset < size_t{record.key_size} + record.value_size || record.ttl < 0) {
+            return false;
+        }
+        K key;
+        V value;
+        if (!SnapshotCodec<K>::Decode(data + offset, record.key_size, &key) ||
+            !SnapshotCodec<V>::Decode(data + offset + record.key_size, record.value_size,
+                                      &value)) {
+            return false;
+        }
+        offset += size_t{record.key_size} + record.value_size;
+        auto ttl =
+            std::chrono::duration_cast<Clock::duration>(std::chrono::nanoseconds(record.ttl));
+        Set(std::move(key), std::move(value), ttl);
+    }
+    return offset == size;
+}
+
+template <class K, class V, class Hash, class Stats>
+size_t LruCache<K, V, Hash, Stats>::Size() const {
+    return index_.Size();
+}
+
+template <class K, class V, class Hash, class Stats>
+size_t LruCache<K, V, Hash, Stats>::Bytes() const {
+    return bytes_;
+}
+
+template <class K, class V, class Hash, class Stats>
+size_t LruCache<K, V, Hash, Stats>::Evictions() const {
+    return evictions_;
+}
+
+template <class K, class V, class Hash, class Stats>
+size_t LruCache<K, V, Hash, Stats>::Expirations() const {
+    return expirations_;
+}
+
+template <class K, class V, class Hash, class Stats>
+CacheStatsSnapshot LruCache<K, V, Hash, Stats>::GetStats() const {
+    return stats_.Snapshot();
+}
+
+template <class K, class V, class Hash, class Stats>
+template <class Key>
+typename LruCache<K, V, Hash, Stats>::Entry* LruCache<K, V, Hash, Stats>::Find(
+    const Key& key, size_t hash) const {
+    return index_.Find(hash, [&key](const Entry& entry) { return entry.key == key; });
+}
+
+template <class K, class V, class Hash, class Stats>
+template <class Key>
+V* LruCache<K, V, Hash, Stats>::GetHashed(const Key& key, size_t hash,
+                                          std::optional<Clock::time_point> now) {
+    Entry* entry = Find(key, hash);
+    if (entry && IsExpired(*entry, now)) {
+        ++expirations_;
+        Erase(entry);
+        entry = nullptr;
+    }
+    if (!entry) {
+        stats_.OnMiss();
+        if (options_.policy == EvictionPolicy::kTinyLfu) {
+            sketch_.Increment(hash);
+        }
+        return nullptr;
+    }
+    stats_.OnHit();
+    Touch(entry);
+    return &entry->value;
+}
+
+template <class K, class V, class Hash, class Stats>
+template <class Key, class Value>
+void LruCache<K, V, Hash, Stats>::SetHashed(Key&& key, size_t hash, Value&& value,
+                                            Clock::duration ttl) {
+    Entry* entry = Find(key, hash);
+    if (entry) {
+        entry->value = std::forward<Value>(value);
+        stats_.OnUpdate();
+        Touch(entry);
+    } else {
+        entry = Insert(std::forward<Key>(key), hash, std::forward<Value>(value));
+    }
+    Commit(entry, ttl);
+}
+
+template <class K, class V, class Hash, class Stats>
+template <class Key, class... Args>
+typename LruCache<K, V, Hash, Stats>::Entry* LruCache<K, V, Hash, Stats>::Insert(
+    Key&& key, size_t hash, Args&&... args) {
+    Entry* entry = new Entry(std::forward<Key>(key), std::forward<Args>(args)...);
+    entry->hash = hash;
+    index_.Insert(hash, entry);
+    stats_.OnInsert();
+    if (options_.policy == EvictionPolicy::kTinyLfu) {
+        sketch_.EnsureCapacity(index_.Size());
+        sketch_.Increment(hash);
+    }
+    Link(entry, kWindow);
+    return entry;
+}
+
+template <class K, class V, class Hash, class Stats>
+void LruCache<K, V, Hash, Stats>::Commit(Entry* entry, Clock::duration ttl) {
+    size_t weight = Weigh(entry->key, entry->value);
+    if (ChargeOf(weight) > options_.capacity) {
+        // Would flush the whole cache and then be evicted itself.
+        Erase(entry);
+        return;
+    }
+    segments_[entry->region].used += ChargeOf(weight) - ChargeOf(entry->weight);
+    bytes_ += weight - entry->weight;
+    entry->weight = weight;
+    auto expires_at = ttl > Clock::duration::zero() ? Now() + ttl : Clock::time_point::max();
+    expiring_ += (expires_at != Clock::time_point::max());
+    expiring_ -= (entry->expires_at != Clock::time_point::max());
+    entry->expires_at = expires_at;
+    EvictIfNeeded();
+}
+
+template <class K, class V, class Hash, class Stats>
+typename LruCache<K, V, Hash, Stats>::Clock::time_point LruCache<K, V, Hash, Stats>::Now()
+    const {
+    return options_.clock ? options_.clock() : Clock::now();
+}
+
+template <class K, class V, class Hash, class Stats>
+bool LruCache<K, V, Hash, Stats>::IsExpired(const Entry& entry,
+                                            std::optional<Clock::time_point> now) const {
+    return entry.expires_at != Clock::time_point::max() &&
+           entry.expires_at <= (now ? *now : Now());
+}
+
+template <class K, class V, class Hash, class Stats>
+size_t LruCache<K, V, Hash, Stats>::Weigh(const K& key, const V& value) const {
+    if (options_.weigher) {
+        return options_.weigher(key, value);
+    }
+    size_t weight = 0;
+    if constexpr (std::is_same_v<K, std::string>) {
+        weight += key.size();
+    } else {
+        weight += sizeof(K);
+    }
+    if constexpr (std::is_same_v<V, std::string>) {
+        weight += value.size();
+    } else {
+        weight += sizeof(V);
+    }
+    return weight;
+}
+
+template <class K, class V, class Hash, class Stats>
+size_t LruCache<K, V, Hash, Stats>::ChargeOf(size_t weight) const {
+    return options_.unit == CapacityUnit::kEntries ? 1 : weight;
+}
+
+template <class K, class V, class Hash, class Stats>
+void LruCache<K, V, Hash, Stats>::Link(Entry* entry, Region region) {
+    entry->region = region;
+    segments_[region].list.PushFront(entry);
+    segments_[region].used += ChargeOf(entry->weight);
+}
+
+template <class K, class V, class Hash, class Stats>
+void LruCache<K, V, Hash, Stats>::Unlink(Entry* entry) {
+    entry->Unlink();
+    segments_[entry->region].used -= ChargeOf(entry->weight);
+}
+
+template <class K, class V, class Hash, class Stats>
+void LruCache<K, V, Hash, Stats>::Touch(Entry* entry) {
+    if (options_.policy == EvictionPolicy::kTinyLfu) {
+        sketch_.Increment(entry->hash);
+    }
+    Segment& segment = segments_[entry->region];
+    if (entry->region != kProbation) {
+        if (&segment.list.Front() != entry) {
+            entry->Unlink();
+            segment.list.PushFront(entry);
+        }
+        return;
+    }
+    Unlink(entry);
+    Link(entry, kProtected);
+    Segment& protected_segment = segments_[kProtected];
+    while (protected_segment.used > protected_segment.capacity) {
+        Entry* demoted = &protected_segment.list.Back();
+        Unlink(demoted);
+        Link(demoted, kProbation);
+    }
+}
+
+template <class K, class V, class Hash, class Stats>
+void LruCache<K, V, Hash, Stats>::Erase(Entry* entry) {
+    Unlink(entry);
+    bytes_ -= entry->weight;
+    expiring_ -= (entry->expires_at != Clock::time_point::max());
+    index_.Erase(entry->hash, entry);
+    delete entry;
+}
+
+template <class K, class V, class Hash, class Stats>
+void LruCache<K, V, Hash, Stats>::Evict(Entry* entry) {
+    ++evictions_;
+    stats_.OnEviction(entry->weight);
+    Erase(entry);
+}
+
+template <class K, class V, class Hash, class Stats>
+void LruCache<K, V, Hash, Stats>::EvictIfNeeded() {
+    Segment& window = segments_[kWindow];
+    while (window.used > window.capacity) {
+        Entry* candidate = &window.list.Back();
+        if (options_.policy == EvictionPolicy::kLru) {
+            Evict(candidate);
+        } else {
+            Unlink(candidate);
+            Link(candidate, kProbation);
+            Admit(candidate);
+        }
+    }
+    if (options_.policy == EvictionPolicy::kTinyLfu) {
+        // Updates may grow entries that already live in the main region.
+        Segment& probation = segments_[kProbation];
+        Segment& protected_segment = segments_[kProtected];
+        while (probation.used + protected_segment.used >
+               probation.capacity + protected_segment.capacity) {
+            Evict(probation.list.IsEmpty() ? &protected_segment.list.Back()
+                                           : &probation.list.Back());
+        }
+    }
+}
+
+template <class K, class V, class Hash, class Stats>
+void LruCache<K, V, Hash, Stats>::Admit(Entry* candidate) {
+    Segment& probation = segments_[kProbation];
+    Segment& protected_segment = segments_[kProtected];
+    size_t main_capacity = probation.capacity + protected_segment.capacity;
+    while (probation.used + protected_segment.used > main_capacity) {
+        Entry* victim = &probation.list.Back();
+        if (victim == candidate && !protected_segment.list.IsEmpty()) {
+            victim = &protected_segment.list.Back();
+        }
+        if (victim == candidate ||
+            sketch_.Frequency(candidate->hash) <= sketch_.Frequency(victim->hash)) {
+            Evict(candidate);
+            return;
+        }
+        Evict(victim);
+    }
+}
+
+// The default instantiation is compiled once, in lru_cache.cpp.
+extern template class LruCache<std::string, std::string>;
@@ -0,0 +1,24 @@
+#include "sharded_lru_cache.h"
+
+template class ShardedLruCache<std::string, std::string>;
+
+BackgroundSweeper::BackgroundSweeper(std::function<void()> sweep,
+                                     std::chrono::steady_clock::duration interval) {
+    thread_ = std::thread([this, sweep = std::move(sweep), interval] {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stop_.wait_for(lock, interval, [this] { return stopped_; })) {
+            lock.unlock();
+            sweep();
+            lock.lock();
+        }
+    });
+}
+
+BackgroundSweeper::~BackgroundSweeper() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopped_ = true;
+    }
+    stop_.notify_one();
+    thread_.join();
+}
@@ -0,0 +1,205 @@
+#pragma once
+
+#include "lru_cache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Thread-safe wrapper: keys are hashed onto independent LruCache shards,
+// each guarded by its own mutex and owning its own slice of max_size.
+// Statistics are kept per shard and summed up by GetStats().
+template <class K = std::string, class V = std::string, class Hash = LruCacheHash<K>,
+          class Stats = NoCacheStats>
+class ShardedLruCache {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static const size_t kDefaultShardsCount = 16;
+
+    ShardedLruCache(size_t max_size, size_t shards_count = kDefaultShardsCount);
+    // options.capacity is split between the shards.
+    explicit ShardedLruCache(const LruCacheOptions<K, V>& options,
+                             size_t shards_count = kDefaultShardsCount);
+
+    template <class Key, class Value>
+    void Set(Key&& key, Value&& value);
+    template <class Key, class Value>
+    void Set(Key&& key, Value&& value, Clock::duration ttl);
+
+    // Copies the value out, since other threads may overwrite it right after the lock is released.
+    template <class Key>
+    bool Get(const Key& key, V* value);
+
+    // Sweeps shards one after another, holding each lock for at most the rest of time_slice.
+    size_t SweepExpired(Clock::duration time_slice);
+
+    size_t ShardsCount() const;
+    size_t Bytes();
+    size_t Evictions();
+    // Does not take the shard locks, so scraping never stalls the cache.
+    CacheStatsSnapshot GetStats() const;
+
+private:
+    // Aligned so that locks of neighbouring shards never share a cache line.
+    struct alignas(64) Shard {
+        explicit Shard(LruCacheOptions<K, V> options) : cache(std::move(options)) {
+        }
+        std::mutex mutex;
+        LruCache<K, V, Hash, Stats> cache;
+    };
+
+    static LruCacheOptions<K, V> EntriesCapacity(size_t max_size);
+
+    template <class Key>
+    Shard& GetShard(const Key& key);
+
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::atomic<size_t> sweep_shard_ = 0;
+};
+
+// Reclaims expired entries of the cache from a dedicated thread,
+// spending at most time_slice every interval.
+class BackgroundSweeper {
+public:
+    template <class Cache>
+    BackgroundSweeper(Cache* cache, std::chrono::steady_clock::duration interval,
+                      std::chrono::steady_clock::duration time_slice)
+        : BackgroundSweeper([cache, time_slice] { cache->SweepExpired(time_slice); },
+                            interval) {
+    }
+    BackgroundSweeper(std::function<void()> sweep, std::chrono::steady_clock::duration interval);
+    ~BackgroundSweeper();
+
+    BackgroundSweeper(const BackgroundSweeper&) = delete;
+    BackgroundSweeper& operator=(const BackgroundSweeper&) = delete;
+
+private:
+    std::mutex mutex_;
+    std::condition_variable stop_;
+    bool stopped_ = false;
+    std::thread thread_;
+};
+
+template <class K, class V, class Hash, class Stats>
+ShardedLruCache<K, V, Hash, Stats>::ShardedLruCache(size_t max_size, size_t shards_count)
+    : ShardedLruCache(EntriesCapacity(max_size), shards_count) {
+}
+
+template <class K, class V, class Hash, class Stats>
+ShardedLruCache<K, V, Hash, Stats>::ShardedLruCache(const LruCacheOptions<K, V>& options,
+                                                    size_t shards_count) {
+    size_t capacity = options.capacity;
+    shards_count = std::max<size_t>(1, shards_count);
+    if (capacity > 0) {
+        shards_count = std::min(shards_count, capacity);
+    }
+    for (size_t i = 0; i < shards_count; ++i) {
+        LruCacheOptions<K, V> slice = options;
+        slice.capacity = capacity / shards_count + (i < capacity % shards_count ? 1 : 0);
+        shards_.emplace_back(std::make_unique<Shard>(std::move(slice)));
+    }
+}
+
+template <class K, class V, class Hash, class Stats>
+template <class Key, class Value>
+void ShardedLruCache<K, V, Hash, Stats>::Set(Key&& key, Value&& value) {
+    Shard& shard = GetShard(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.cache.Set(std::forward<Key>(key), std::forward<Value>(value));
+}
+
+template <class K, class V, class Hash, class Stats>
+template <class Key, class Value>
+void ShardedLruCache<K, V, Hash, Stats>::Set(Key&& key, Value&& value, Clock::duration ttl) {
+    Shard& shard = GetShard(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.cache.Set(std::forward<Key>(key), std::forward<Value>(value), ttl);
+}
+
+template <class K, class V, class Hash, class Stats>
+template <class Key>
+bool ShardedLruCache<K, V, Hash, Stats>::Get(const Key& key, V* value) {
+    Shard& shard = GetShard(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.cache.Get(key, value);
+}
+
+template <class K, class V, class Hash, class Stats>
+size_t ShardedLruCache<K, V, Hash, Stats>::SweepExpired(Clock::duration time_slice) {
+    auto deadline = Clock::now() + time_slice;
+    size_t removed = 0;
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        auto left = deadline - Clock::now();
+        if (left <= Clock::duration::zero()) {
+            break;
+        }
+        Shard& shard = *shards_[sweep_shard_++ % shards_.size()];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        removed += shard.cache.SweepExpired(left);
+    }
+    return removed;
+}
+
+template <class K, class V, class Hash, class Stats>
+size_t ShardedLruCache<K, V, Hash, Stats>::ShardsCount() const {
+    return shards_.size();
+}
+
+template <class K, class V, class Hash, class Stats>
+size_t ShardedLruCache<K, V, Hash, Stats>::Bytes() {
+    size_t bytes = 0;
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        bytes += shard->cache.Bytes();
+    }
+    return bytes;
+}
+
+template <class K, class V, class Hash, class Stats>
+size_t ShardedLruCache<K, V, Hash, Stats>::Evictions() {
+    size_t evictions = 0;
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        evictions += shard->cache.Evictions();
+    }
+    return evictions;
+}
+
+template <class K, class V, class Hash, class Stats>
+CacheStatsSnapshot ShardedLruCache<K, V, Hash, Stats>::GetStats() const {
+    CacheStatsSnapshot stats;
+    for (auto& shard : shards_) {
+        stats += shard->cache.GetStats();
+    }
+    return stats;
+}
+
+template <class K, class V, class Hash, class Stats>
+LruCacheOptions<K, V> ShardedLruCache<K, V, Hash, Stats>::EntriesCapacity(size_t max_size) {
+    LruCacheOptions<K, V> options;
+    options.capacity = max_size;
+    return options;
+}
+
+template <class K, class V, class Hash, class Stats>
+template <class Key>
+typename ShardedLruCache<K, V, Hash, Stats>::Shard&
+ShardedLruCache<K, V, Hash, Stats>::GetShard(const Key& key) {
+    size_t hash = Hash{}(key);
+    // Fold the high half in so that the shard index is not correlated
+    // with the bucket index inside the shard.
+    hash ^= hash >> (sizeof(size_t) * 4);
+    return *shards_[hash % shards_.size()];
+}
+
+// The default instantiation is compiled once, in sharded_lru_cache.cpp.
+extern template class ShardedLruCache<std::string, std::string>;
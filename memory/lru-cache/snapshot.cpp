@@ -0,0 +1,93 @@
+#include "snapshot.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+
+namespace {
+
+const size_t kWriteBufferSize = 1 << 20;
+
+}  // namespace
+
+SnapshotWriter::SnapshotWriter(const std::string& path)
+    : path_(path), temp_path_(path + ".tmp") {
+    fd_ = open(temp_path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    failed_ = fd_ < 0;
+    buffer_.reserve(kWriteBufferSize);
+}
+
+SnapshotWriter::~SnapshotWriter() {
+    if (fd_ >= 0) {
+        close(fd_);
+        unlink(temp_path_.c_str());
+    }
+}
+
+void SnapshotWriter::Write(const void* data, size_t size) {
+    if (buffer_.size() + size > kWriteBufferSize) {
+        Flush();
+    }
+    buffer_.append(static_cast<const char*>(data), size);
+}
+
+bool SnapshotWriter::Commit() {
+    Flush();
+    failed_ |= fsync(fd_) != 0;
+    failed_ |= close(fd_) != 0;
+    fd_ = -1;
+    if (failed_ || std::rename(temp_path_.c_str(), path_.c_str()) != 0) {
+        unlink(temp_path_.c_str());
+        return false;
+    }
+    return true;
+}
+
+void SnapshotWriter::Flush() {
+    for (size_t done = 0; !failed_ && done < buffer_.size();) {
+        ssize_t written = write(fd_, buffer_.data() + done, buffer_.size() - done);
+        if (written < 0) {
+            failed_ = errno != EINTR;
+        } else {
+            done += written;
+        }
+    }
+    buffer_.clear();
+}
+
+MappedFile::MappedFile(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            // Snapshots are read front to back exactly once.
+            madvise(data, st.st_size, MADV_SEQUENTIAL);
+            data_ = data;
+            size_ = st.st_size;
+        }
+    }
+    // The mapping keeps the file alive on its own.
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (data_) {
+        munmap(data_, size_);
+    }
+}
+
+const char* MappedFile::Data() const {
+    return static_cast<const char*>(data_);
+}
+
+size_t MappedFile::Size() const {
+    return size_;
+}
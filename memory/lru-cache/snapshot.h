@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+// A snapshot file is a SnapshotHeader followed by header.count records, each of
+// them a SnapshotRecord, then key_size bytes of key and value_size bytes of value.
+// Integers are stored in the host byte order, there is no padding.
+struct SnapshotHeader {
+    char magic[8];
+    uint64_t version;
+    uint64_t count;
+};
+
+struct SnapshotRecord {
+    uint32_t key_size;
+    uint32_t value_size;
+    // Nanoseconds the entry had left to live when saved, zero if it never expires.
+    int64_t ttl;
+};
+
+inline constexpr char kSnapshotMagic[8] = {'L', 'R', 'U', 'S', 'N', 'A', 'P', '\0'};
+inline constexpr uint64_t kSnapshotVersion = 1;
+
+// How keys and values are laid out in a snapshot. Defined for std::string and
+// trivially copyable types, other types need a specialization of their own.
+template <class T>
+struct SnapshotCodec;
+
+template <>
+struct SnapshotCodec<std::string> {
+    static const void* Data(const std::string& s) {
+        return s.data();
+    }
+    static size_t Size(const std::string& s) {
+        return s.size();
+    }
+    static bool Decode(const char* data, size_t size, std::string* s) {
+        s->assign(data, size);
+        return true;
+    }
+};
+
+template <class T>
+requires std::is_trivially_copyable_v<T>
+struct SnapshotCodec<T> {
+    static const void* Data(const T& x) {
+        return &x;
+    }
+    static size_t Size(const T&) {
+        return sizeof(T);
+    }
+    static bool Decode(const char* data, size_t size, T* x) {
+        if (size != sizeof(T)) {
+            return false;
+        }
+        std::memcpy(x, data, size);
+        return true;
+    }
+};
+
+// Buffered writer to a temporary file next to path, which replaces path only
+// on Commit, so that a crash in the middle never leaves a truncated snapshot.
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(const std::string& path);
+    // Removes the temporary file unless committed.
+    ~SnapshotWriter();
+
+    SnapshotWriter(const SnapshotWriter&) = delete;
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+    void Write(const void* data, size_t size);
+    // Returns false if anything failed since the file was opened.
+    bool Commit();
+
+private:
+    void Flush();
+
+    std::string path_;
+    std::string temp_path_;
+    int fd_ = -1;
+    bool failed_ = false;
+    std::string buffer_;
+};
+
+// Whole file mapped read-only. Data() is nullptr if the file could not be mapped.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* Data() const;
+    size_t Size() const;
+
+private:
+    void* data_ = nullptr;
+    size_t size_ = 0;
+};
@@ -1,6 +1,23 @@
 #include <catch.hpp>
 #include <util.h>
+#include <cache_stats.h>
+#include <flat_index.h>
 #include <lru_cache.h>
+#include <sharded_lru_cache.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 
 TEST_CASE("Set and get", "[LruCache]") {
     LruCache cache(10);
@@ -66,3 +83,791 @@ TEST_CASE("Stress", "[LruCache]") {
         }
     }
 }
+
+TEST_CASE("Sharded set and get", "[ShardedLruCache]") {
+    ShardedLruCache cache(100, 4);
+    REQUIRE(cache.ShardsCount() == 4u);
+
+    std::string value;
+    for (int i = 0; i < 50; ++i) {
+        cache.Set(std::to_string(i), std::to_string(i * 2));
+    }
+    for (int i = 0; i < 50; ++i) {
+        REQUIRE(cache.Get(std::to_string(i), &value));
+        REQUIRE(std::to_string(i * 2) == value);
+    }
+    REQUIRE(!cache.Get("foo", &value));
+}
+
+TEST_CASE("Sharded capacity is split between shards", "[ShardedLruCache]") {
+    ShardedLruCache small(3, 16);
+    REQUIRE(small.ShardsCount() == 3u);
+
+    ShardedLruCache cache(64, 8);
+    std::string value;
+    for (int i = 0; i < 1000; ++i) {
+        cache.Set(std::to_string(i), "foo");
+    }
+    size_t found = 0;
+    for (int i = 0; i < 1000; ++i) {
+        found += cache.Get(std::to_string(i), &value);
+    }
+    REQUIRE(found <= 64u);
+    REQUIRE(cache.Get("999", &value));
+}
+
+TEST_CASE("Sharded concurrent access", "[ShardedLruCache]") {
+    ShardedLruCache cache(256, 8);
+    std::atomic<int> mismatches = 0;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&cache, &mismatches, t] {
+            RandomGenerator random(t);
+            std::string value;
+            for (int i = 0; i < 20000; ++i) {
+                auto key = std::to_string(random.GenInt<uint32_t>() % 1000);
+                if (i % 3 == 0) {
+                    cache.Set(key, key);
+                } else if (cache.Get(key, &value) && key != value) {
+                    ++mismatches;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    REQUIRE(mismatches == 0);
+}
+
+TEST_CASE("String view keys", "[LruCache]") {
+    LruCache cache(2);
+    std::string value;
+
+    std::string_view key = "key";
+    cache.Set(key, std::string_view("value"));
+    REQUIRE(cache.Get(key, &value));
+    REQUIRE("value" == value);
+
+    std::string buffer = "xkeyx";
+    REQUIRE(cache.Get(std::string_view(buffer).substr(1, 3), &value));
+    REQUIRE(!cache.Get(std::string_view(buffer).substr(0, 3), &value));
+    REQUIRE(cache.Size() == 1u);
+}
+
+TEST_CASE("Hit moves entry to the front", "[LruCache]") {
+    LruCache cache(3);
+    std::string value;
+
+    cache.Set("a", "1");
+    cache.Set("b", "2");
+    cache.Set("c", "3");
+    REQUIRE(cache.Get("a", &value));
+    REQUIRE(cache.Get("a", &value));
+    cache.Set("d", "4");
+    cache.Set("e", "5");
+
+    REQUIRE(cache.Size() == 3u);
+    REQUIRE(cache.Get("a", &value));
+    REQUIRE("1" == value);
+    REQUIRE(!cache.Get("b", &value));
+    REQUIRE(!cache.Get("c", &value));
+}
+
+TEST_CASE("Byte budget", "[LruCache]") {
+    LruCacheOptions options;
+    options.capacity = 10;
+    options.unit = CapacityUnit::kBytes;
+    LruCache cache(options);
+    std::string value;
+
+    cache.Set("a", "1234");
+    cache.Set("b", "5678");
+    REQUIRE(cache.Bytes() == 10u);
+    REQUIRE(cache.Evictions() == 0u);
+
+    cache.Set("c", "9");
+    REQUIRE(cache.Bytes() == 7u);
+    REQUIRE(cache.Evictions() == 1u);
+    REQUIRE(!cache.Get("a", &value));
+
+    cache.Set("c", "123456789");
+    REQUIRE(cache.Bytes() == 10u);
+    REQUIRE(cache.Size() == 1u);
+    REQUIRE(cache.Evictions() == 2u);
+
+    cache.Set("d", std::string(100, 'x'));
+    REQUIRE(!cache.Get("d", &value));
+    REQUIRE(cache.Get("c", &value));
+    REQUIRE(cache.Bytes() == 10u);
+
+    cache.Set("c", std::string(100, 'x'));
+    REQUIRE(!cache.Get("c", &value));
+    REQUIRE(cache.Bytes() == 0u);
+}
+
+TEST_CASE("Custom weigher", "[LruCache]") {
+    LruCacheOptions options;
+    options.capacity = 100;
+    options.unit = CapacityUnit::kBytes;
+    options.weigher = [](std::string_view, std::string_view value) {
+        return value.size() * 10;
+    };
+    LruCache cache(options);
+    std::string value;
+
+    for (int i = 0; i < 10; ++i) {
+        cache.Set(std::to_string(i), "x");
+    }
+    REQUIRE(cache.Bytes() == 100u);
+    cache.Set("big", "xx");
+    REQUIRE(cache.Bytes() == 100u);
+    REQUIRE(cache.Evictions() == 2u);
+    REQUIRE(!cache.Get("0", &value));
+    REQUIRE(!cache.Get("1", &value));
+    REQUIRE(cache.Get("2", &value));
+}
+
+TEST_CASE("Bytes are tracked in entries mode", "[LruCache]") {
+    LruCache cache(2);
+    cache.Set("aa", "bb");
+    cache.Set("c", "d");
+    cache.Set("e", "f");
+    REQUIRE(cache.Size() == 2u);
+    REQUIRE(cache.Bytes() == 4u);
+    REQUIRE(cache.Evictions() == 1u);
+}
+
+TEST_CASE("Sharded byte budget", "[ShardedLruCache]") {
+    LruCacheOptions options;
+    options.capacity = 1000;
+    options.unit = CapacityUnit::kBytes;
+    ShardedLruCache cache(options, 4);
+    for (int i = 0; i < 1000; ++i) {
+        cache.Set(std::to_string(i), std::string(10, 'x'));
+    }
+    REQUIRE(cache.Bytes() <= 1000u);
+    REQUIRE(cache.Evictions() > 0u);
+}
+
+TEST_CASE("Frequency sketch", "[FrequencySketch]") {
+    FrequencySketch sketch(128);
+    REQUIRE(sketch.Frequency(42) == 0);
+    for (int i = 0; i < 5; ++i) {
+        sketch.Increment(42);
+    }
+    REQUIRE(sketch.Frequency(42) >= 5);
+    for (int i = 0; i < 100; ++i) {
+        sketch.Increment(7);
+    }
+    REQUIRE(sketch.Frequency(7) == 15);
+
+    // Enough distinct increments trigger aging, which halves the counters.
+    for (uint64_t i = 1000; i < 10000; ++i) {
+        sketch.Increment(i);
+    }
+    REQUIRE(sketch.Frequency(7) < 15);
+}
+
+TEST_CASE("TinyLFU set and get", "[LruCache]") {
+    LruCacheOptions options;
+    options.capacity = 10;
+    options.policy = EvictionPolicy::kTinyLfu;
+    LruCache cache(options);
+    std::string value;
+
+    cache.Set("a", "1");
+    cache.Set("b", "2");
+    REQUIRE(cache.Get("a", &value));
+    REQUIRE("1" == value);
+    cache.Set("a", "3");
+    REQUIRE(cache.Get("a", &value));
+    REQUIRE("3" == value);
+
+    RandomGenerator random;
+    for (size_t i = 0; i < 10000; ++i) {
+        auto key = std::to_string(random.GenInt<uint32_t>() % 50);
+        if (i % 2 == 0) {
+            cache.Set(key, key);
+        } else if (cache.Get(key, &value)) {
+            REQUIRE(key == value);
+        }
+        REQUIRE(cache.Size() <= 10u);
+    }
+}
+
+TEST_CASE("TinyLFU survives a scan", "[LruCache]") {
+    // Hot keys are read once per 500 scanned keys, which is too rare for plain LRU.
+    auto hot_hits = [](EvictionPolicy policy) {
+        LruCacheOptions options;
+        options.capacity = 100;
+        options.policy = policy;
+        LruCache cache(options);
+        std::string value;
+        auto get_hot = [&cache, &value](int i) {
+            auto key = "hot" + std::to_string(i % 50);
+            if (cache.Get(key, &value)) {
+                return 1;
+            }
+            cache.Set(key, "foo");
+            return 0;
+        };
+        for (int i = 0; i < 500; ++i) {
+            get_hot(i);
+        }
+        int hits = 0;
+        for (int i = 0; i < 100000; ++i) {
+            cache.Set("scan" + std::to_string(i), "bar");
+            if (i % 10 == 0) {
+                hits += get_hot(i / 10);
+            }
+        }
+        return hits;
+    };
+
+    REQUIRE(hot_hits(EvictionPolicy::kLru) < 100);
+    REQUIRE(hot_hits(EvictionPolicy::kTinyLfu) >= 9900);
+}
+
+TEST_CASE("TinyLFU byte budget", "[LruCache]") {
+    LruCacheOptions options;
+    options.capacity = 1000;
+    options.unit = CapacityUnit::kBytes;
+    options.policy = EvictionPolicy::kTinyLfu;
+    LruCache cache(options);
+
+    RandomGenerator random;
+    for (size_t i = 0; i < 10000; ++i) {
+        auto key = std::to_string(random.GenInt<uint32_t>() % 300);
+        cache.Set(key, std::string(random.GenInt<uint32_t>() % 50, 'x'));
+        REQUIRE(cache.Bytes() <= 1000u);
+    }
+    REQUIRE(cache.Evictions() > 0u);
+}
+
+TEST_CASE("Entries expire", "[LruCache]") {
+    auto now = LruCache<>::Clock::time_point();
+    LruCacheOptions options;
+    options.capacity = 10;
+    options.default_ttl = std::chrono::seconds(10);
+    options.clock = [&now] { return now; };
+    LruCache cache(options);
+    std::string value;
+
+    cache.Set("a", "1");
+    cache.Set("b", "2", std::chrono::seconds(30));
+    cache.Set("c", "3", LruCache<>::Clock::duration::zero());
+
+    now += std::chrono::seconds(5);
+    REQUIRE(cache.Get("a", &value));
+    REQUIRE("1" == value);
+
+    now += std::chrono::seconds(5);
+    REQUIRE(!cache.Get("a", &value));
+    REQUIRE(cache.Size() == 2u);
+    REQUIRE(cache.Expirations() == 1u);
+    REQUIRE(cache.Get("b", &value));
+
+    cache.Set("b", "4");
+    now += std::chrono::seconds(25);
+    REQUIRE(!cache.Get("b", &value));
+    REQUIRE(cache.Get("c", &value));
+    REQUIRE("3" == value);
+    REQUIRE(cache.Expirations() == 2u);
+}
+
+TEST_CASE("Sweeping expired entries", "[LruCache]") {
+    auto now = LruCache<>::Clock::time_point();
+    LruCacheOptions options;
+    options.capacity = 1000;
+    options.clock = [&now] { return now; };
+    LruCache cache(options);
+
+    for (int i = 0; i < 1000; ++i) {
+        cache.Set(std::to_string(i), "foo", std::chrono::seconds(i % 2 == 0 ? 1 : 100));
+    }
+    REQUIRE(cache.SweepExpired(std::chrono::seconds(1)) == 0u);
+
+    now += std::chrono::seconds(10);
+    // The fake clock does not move, so the slice is never exhausted.
+    REQUIRE(cache.SweepExpired(std::chrono::seconds(1)) == 500u);
+    REQUIRE(cache.Size() == 500u);
+    REQUIRE(cache.Expirations() == 500u);
+
+    // A zero slice still makes progress.
+    now += std::chrono::seconds(100);
+    size_t removed = 0;
+    for (int i = 0; i < 10000 && cache.Size() > 0; ++i) {
+        removed += cache.SweepExpired(LruCache<>::Clock::duration::zero());
+    }
+    REQUIRE(removed == 500u);
+}
+
+TEST_CASE("Background sweeper", "[ShardedLruCache]") {
+    ShardedLruCache cache(1000, 4);
+    for (int i = 0; i < 100; ++i) {
+        cache.Set(std::to_string(i), "foo", std::chrono::milliseconds(1));
+    }
+    cache.Set("forever", "bar");
+    {
+        BackgroundSweeper sweeper(&cache, std::chrono::milliseconds(1), std::chrono::milliseconds(1));
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    REQUIRE(cache.Bytes() == std::string("foreverbar").size());
+}
+
+TEST_CASE("Integer keys and struct values", "[LruCache]") {
+    struct Point {
+        int x = 0;
+        int y = 0;
+    };
+    LruCache<int, Point> cache(2);
+
+    cache.Set(1, Point{1, 2});
+    cache.Emplace(2, Point{3, 4});
+    Point* point = cache.Get(1);
+    REQUIRE(point);
+    REQUIRE(point->y == 2);
+    point->y = 5;
+    REQUIRE(cache.Get(1)->y == 5);
+
+    cache.Set(3, Point{});
+    REQUIRE(!cache.Get(2));
+    REQUIRE(cache.Get(3));
+    REQUIRE(cache.Bytes() == 2 * (sizeof(int) + sizeof(Point)));
+}
+
+TEST_CASE("Move-only values", "[LruCache]") {
+    LruCache<std::string, std::unique_ptr<std::string>> cache(2);
+
+    auto value = std::make_unique<std::string>("foo");
+    auto* raw = value.get();
+    cache.Set("a", std::move(value));
+    REQUIRE(cache.Get("a")->get() == raw);
+
+    cache.Emplace(std::string("b"), new std::string("bar"));
+    REQUIRE(**cache.Get(std::string_view("b")) == "bar");
+    cache.Emplace("b", new std::string("baz"));
+    REQUIRE(**cache.Get("b") == "baz");
+    REQUIRE(cache.Size() == 2u);
+}
+
+TEST_CASE("Emplace replaces immovable values in place", "[LruCache]") {
+    struct Counter {
+        explicit Counter(int value) : value(value) {
+            if (value < 0) {
+                throw std::runtime_error("negative counter");
+            }
+        }
+        Counter(const Counter&) = delete;
+        Counter& operator=(const Counter&) = delete;
+
+        std::atomic<int> value;
+    };
+    LruCache<std::string, Counter> cache(2);
+
+    cache.Emplace("a", 1);
+    cache.Emplace("b", 2);
+    cache.Emplace("a", 3);
+    REQUIRE(cache.Get("a")->value == 3);
+    REQUIRE(cache.Size() == 2u);
+
+    // A throwing constructor leaves the old value in place.
+    REQUIRE_THROWS(cache.Emplace("a", -1));
+    REQUIRE(cache.Get("a")->value == 3);
+    REQUIRE(cache.Size() == 2u);
+    REQUIRE(cache.Bytes() == 2 * (std::string("a").size() + sizeof(Counter)));
+    cache.Emplace("a", 4);
+    REQUIRE(cache.Get("a")->value == 4);
+}
+
+TEST_CASE("Emplace from the value it replaces", "[LruCache]") {
+    LruCacheOptions options;
+    options.capacity = 100;
+    options.unit = CapacityUnit::kBytes;
+    LruCache cache(options);
+    cache.Set("a", std::string(20, 'x'));
+    cache.Set("b", "1");
+
+    cache.Emplace("a", *cache.Get("a"), 5, 10);
+    REQUIRE(*cache.Get("a") == std::string(10, 'x'));
+    cache.Emplace("b", *cache.Get("b"));
+    REQUIRE(*cache.Get("b") == "1");
+    REQUIRE(cache.Size() == 2u);
+    REQUIRE(cache.Bytes() == std::string("a").size() + 10 + std::string("b").size() + 1);
+}
+
+TEST_CASE("Keys and values are moved in", "[LruCache]") {
+    LruCache cache(2);
+    std::string key(100, 'k');
+    std::string value(100, 'v');
+    const char* value_data = value.data();
+
+    cache.Set(std::move(key), std::move(value));
+    std::string* stored = cache.Get(std::string(100, 'k'));
+    REQUIRE(stored);
+    REQUIRE(stored->data() == value_data);
+}
+
+TEST_CASE("Generic sharded cache", "[ShardedLruCache]") {
+    ShardedLruCache<uint64_t, int> cache(100, 4);
+    for (uint64_t i = 0; i < 50; ++i) {
+        cache.Set(i, static_cast<int>(i) * 2);
+    }
+    int value = 0;
+    REQUIRE(cache.Get(uint64_t{7}, &value));
+    REQUIRE(value == 14);
+    REQUIRE(!cache.Get(uint64_t{70}, &value));
+}
+
+TEST_CASE("Flat index", "[FlatIndex]") {
+    struct Item {
+        int key;
+    };
+    // Few hash values, so that probe sequences collide and wrap around.
+    auto hash = [](int key) { return static_cast<size_t>(key % 37); };
+    auto find = [&hash](const FlatIndex<Item>& index, int key) {
+        return index.Find(hash(key), [key](const Item& item) { return item.key == key; });
+    };
+
+    FlatIndex<Item> index;
+    std::vector<std::unique_ptr<Item>> items;
+    for (int i = 0; i < 1000; ++i) {
+        items.push_back(std::make_unique<Item>(Item{i}));
+    }
+    std::vector<bool> present(items.size());
+
+    RandomGenerator random;
+    for (int i = 0; i < 100000; ++i) {
+        int key = random.GenInt<uint32_t>() % items.size();
+        if (present[key]) {
+            REQUIRE(find(index, key) == items[key].get());
+            index.Erase(hash(key), items[key].get());
+        } else {
+            REQUIRE(!find(index, key));
+            index.Insert(hash(key), items[key].get());
+        }
+        present[key] = !present[key];
+    }
+
+    size_t size = 0;
+    for (size_t slot = 0; slot < index.SlotsCount(); ++slot) {
+        if (Item* item = index.At(slot)) {
+            REQUIRE(present[item->key]);
+            ++size;
+        }
+    }
+    REQUIRE(size == index.Size());
+    REQUIRE(index.Size() == static_cast<size_t>(std::count(present.begin(), present.end(), true)));
+}
+
+TEST_CASE("MultiGet and MultiSet", "[LruCache]") {
+    LruCache cache(100);
+    std::vector<std::string> keys;
+    std::vector<std::string> values;
+    for (int i = 0; i < 50; ++i) {
+        keys.push_back(std::to_string(i));
+        values.push_back(std::to_string(i * 2));
+    }
+    cache.MultiSet(keys, values);
+    REQUIRE(cache.Size() == 50u);
+
+    keys.push_back("missing");
+    std::vector<std::string*> found(keys.size());
+    REQUIRE(cache.MultiGet(keys, found) == 50u);
+    for (int i = 0; i < 50; ++i) {
+        REQUIRE(found[i]);
+        REQUIRE(*found[i] == values[i]);
+    }
+    REQUIRE(!found.back());
+
+    std::vector<std::string_view> views = {"1", "2", "nope"};
+    std::vector<std::string*> by_view(views.size());
+    REQUIRE(cache.MultiGet(std::span<const std::string_view>(views), by_view) == 2u);
+    REQUIRE(*by_view[1] == "4");
+
+    std::vector<std::string*> short_values(keys.size() - 1);
+    REQUIRE_THROWS_AS(cache.MultiGet(keys, short_values), std::invalid_argument);
+    REQUIRE_THROWS_AS(cache.MultiSet(std::span<const std::string>(keys),
+                                     std::span<const std::string>(values)),
+                      std::invalid_argument);
+}
+
+TEST_CASE("MultiGet pointers outlive the batch clock", "[LruCache]") {
+    // Every reading of this clock is a second later than the previous one.
+    auto now = LruCache<>::Clock::time_point();
+    LruCacheOptions options;
+    options.capacity = 10;
+    options.clock = [&now] { return now += std::chrono::seconds(1); };
+    LruCache cache(options);
+    cache.Set("a", "1", std::chrono::seconds(3));
+
+    // Lookups one by one would see the entry expire at the third repeat and
+    // erase it under the pointers already returned.
+    std::vector<std::string> keys(4, "a");
+    std::vector<std::string*> found(keys.size());
+    REQUIRE(cache.MultiGet(keys, found) == 4u);
+    for (auto* value : found) {
+        REQUIRE(value == found[0]);
+        REQUIRE(*value == "1");
+    }
+}
+
+TEST_CASE("MultiGet matches Get", "[LruCache]") {
+    LruCache<int, int> batched(64);
+    LruCache<int, int> single(64);
+    RandomGenerator random;
+    for (int round = 0; round < 1000; ++round) {
+        std::vector<int> keys(1 + random.GenInt<uint32_t>() % 40);
+        for (auto& key : keys) {
+            key = random.GenInt<uint32_t>() % 200;
+        }
+        if (round % 2 == 0) {
+            batched.MultiSet(keys, keys);
+            for (int key : keys) {
+                single.Set(key, key);
+            }
+        } else {
+            std::vector<int*> values(keys.size());
+            batched.MultiGet(keys, values);
+            for (size_t i = 0; i < keys.size(); ++i) {
+                int* expected = single.Get(keys[i]);
+                REQUIRE((values[i] == nullptr) == (expected == nullptr));
+            }
+        }
+    }
+}
+
+namespace {
+
+std::string SnapshotPath(const std::string& name) {
+    return (std::filesystem::temp_directory_path() / ("lru_cache_" + name + ".snapshot")).string();
+}
+
+}  // namespace
+
+TEST_CASE("Snapshot restores entries and recency", "[LruCache]") {
+    auto path = SnapshotPath("recency");
+    LruCache cache(3);
+    cache.Set("a", "1");
+    cache.Set("b", "2");
+    cache.Set("c", "3");
+    cache.Get("a");
+    REQUIRE(cache.SaveSnapshot(path));
+
+    LruCache restored(3);
+    REQUIRE(restored.LoadSnapshot(path));
+    REQUIRE(restored.Size() == 3u);
+    REQUIRE(restored.Bytes() == cache.Bytes());
+    // "b" is the least recently used one, both before and after the restart.
+    restored.Set("d", "4");
+    REQUIRE(!restored.Get("b"));
+    REQUIRE(*restored.Get("a") == "1");
+    REQUIRE(*restored.Get("c") == "3");
+    REQUIRE(*restored.Get("d") == "4");
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Snapshot keeps time to live", "[LruCache]") {
+    auto path = SnapshotPath("ttl");
+    auto now = LruCache<>::Clock::time_point();
+    LruCacheOptions options;
+    options.capacity = 10;
+    options.clock = [&now] { return now; };
+    LruCache cache(options);
+    cache.Set("forever", "1");
+    cache.Set("short", "2", std::chrono::seconds(10));
+    cache.Set("expired", "3", std::chrono::seconds(1));
+    now += std::chrono::seconds(5);
+    REQUIRE(cache.SaveSnapshot(path));
+
+    LruCache restored(options);
+    REQUIRE(restored.LoadSnapshot(path));
+    REQUIRE(restored.Size() == 2u);
+    now += std::chrono::seconds(4);
+    REQUIRE(restored.Get("short"));
+    now += std::chrono::seconds(2);
+    REQUIRE(!restored.Get("short"));
+    REQUIRE(restored.Get("forever"));
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Snapshot of integer keys", "[LruCache]") {
+    auto path = SnapshotPath("ints");
+    LruCacheOptions<uint64_t, double> options;
+    options.capacity = 1000;
+    options.policy = EvictionPolicy::kTinyLfu;
+    LruCache<uint64_t, double> cache(options);
+    for (uint64_t i = 0; i < 1000; ++i) {
+        cache.Set(i, i * 0.5);
+    }
+    REQUIRE(cache.SaveSnapshot(path));
+
+    LruCache<uint64_t, double> restored(options);
+    REQUIRE(restored.LoadSnapshot(path));
+    REQUIRE(restored.Size() == cache.Size());
+    for (uint64_t i = 0; i < 1000; ++i) {
+        double value = 0;
+        REQUIRE(cache.Get(i, &value) == restored.Get(i, &value));
+    }
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Malformed snapshots", "[LruCache]") {
+    auto path = SnapshotPath("malformed");
+    LruCache cache(10);
+    REQUIRE(!cache.LoadSnapshot(path + ".missing"));
+
+    {
+        std::ofstream out(path, std::ios::binary);
+        out << "not a snapshot at all";
+    }
+    REQUIRE(!cache.LoadSnapshot(path));
+
+    LruCache source(10);
+    source.Set("a", "1");
+    source.Set("b", std::string(100, 'b'));
+    REQUIRE(source.SaveSnapshot(path));
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+    REQUIRE(!cache.LoadSnapshot(path));
+    // Entries before the truncated one are still loaded.
+    REQUIRE(cache.Size() == 1u);
+    REQUIRE(*cache.Get("a") == "1");
+
+    // A snapshot of a different value type does not decode.
+    LruCache<std::string, uint64_t> other(10);
+    REQUIRE(!other.LoadSnapshot(path));
+    std::remove(path.c_str());
+}
+
+namespace {
+
+// A value whose encoding claims to be larger than a snapshot record can describe.
+struct MaybeHuge {
+    bool huge = false;
+};
+
+}  // namespace
+
+template <>
+struct SnapshotCodec<MaybeHuge> {
+    static const void* Data(const MaybeHuge& x) {
+        return &x;
+    }
+    static size_t Size(const MaybeHuge& x) {
+        return x.huge ? size_t{UINT32_MAX} + 1 : sizeof(x);
+    }
+    static bool Decode(const char* data, size_t size, MaybeHuge* x) {
+        if (size != sizeof(*x)) {
+            return false;
+        }
+        std::memcpy(x, data, size);
+        return true;
+    }
+};
+
+TEST_CASE("Snapshot skips entries too large for a record", "[LruCache]") {
+    auto path = SnapshotPath("huge");
+    LruCache<std::string, MaybeHuge> cache(10);
+    cache.Set("small", MaybeHuge{false});
+    cache.Set("huge", MaybeHuge{true});
+    cache.Set("other", MaybeHuge{false});
+    REQUIRE(cache.SaveSnapshot(path));
+
+    LruCache<std::string, MaybeHuge> restored(10);
+    REQUIRE(restored.LoadSnapshot(path));
+    REQUIRE(restored.Size() == 2u);
+    REQUIRE(restored.Get("small"));
+    REQUIRE(restored.Get("other"));
+    REQUIRE(!restored.Get("huge"));
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Statistics counters", "[LruCache]") {
+    LruCacheOptions options;
+    options.capacity = 10;
+    options.unit = CapacityUnit::kBytes;
+    LruCache<std::string, std::string, LruCacheHash<std::string>, CacheStats> cache(options);
+
+    cache.Set("a", "1");
+    cache.Set("b", "22");
+    cache.Set("a", "3");
+    REQUIRE(cache.Get("a"));
+    REQUIRE(!cache.Get("c"));
+    cache.Set("cccc", "4444");
+
+    auto stats = cache.GetStats();
+    REQUIRE(stats.hits == 1u);
+    REQUIRE(stats.misses == 1u);
+    REQUIRE(stats.inserts == 3u);
+    REQUIRE(stats.updates == 1u);
+    REQUIRE(stats.evictions == 1u);
+    REQUIRE(stats.evicted_bytes == 3u);
+
+    for (uint64_t i = 0; i < 10 * CacheStats::kLatencySampleRate; ++i) {
+        cache.Get("a");
+    }
+    stats = cache.GetStats();
+    REQUIRE(stats.get_latency.Count() >= 10u);
+    REQUIRE(stats.get_latency.Percentile(0.5) > std::chrono::nanoseconds::zero());
+
+    LruCache plain(10);
+    plain.Set("a", "1");
+    plain.Get("a");
+    REQUIRE(plain.GetStats().hits == 0u);
+}
+
+TEST_CASE("Latency histogram", "[LruCache]") {
+    LatencyHistogram histogram;
+    REQUIRE(histogram.Percentile(0.99) == std::chrono::nanoseconds::zero());
+    for (int i = 0; i < 90; ++i) {
+        histogram.Record(std::chrono::nanoseconds(100));
+    }
+    for (int i = 0; i < 10; ++i) {
+        histogram.Record(std::chrono::microseconds(100));
+    }
+    REQUIRE(histogram.Count() == 100u);
+    REQUIRE(histogram.BucketCount(6) == 90u);
+    REQUIRE(histogram.Percentile(0.5) == std::chrono::nanoseconds(128));
+    REQUIRE(histogram.Percentile(0.9) == std::chrono::nanoseconds(128));
+    REQUIRE(histogram.Percentile(0.95) == std::chrono::nanoseconds(131072));
+    histogram.Record(std::chrono::hours(1));
+    REQUIRE(histogram.BucketCount(LatencyHistogram::kBucketsCount - 1) == 1u);
+}
+
+TEST_CASE("Sharded statistics", "[ShardedLruCache]") {
+    const int kThreads = 4;
+    const int kKeys = 1000;
+    // Shards are sized with room to spare, since keys do not spread between them evenly.
+    ShardedLruCache<std::string, std::string, LruCacheHash<std::string>, CacheStats> cache(
+        4 * kThreads * kKeys, 8);
+    std::atomic<bool> done = false;
+    std::thread scraper([&cache, &done] {
+        while (!done) {
+            cache.GetStats();
+        }
+    });
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&cache, t] {
+            std::string value;
+            for (int i = 0; i < kKeys; ++i) {
+                auto key = std::to_string(t * kKeys + i);
+                cache.Get(key, &value);
+                cache.Set(key, "foo");
+                cache.Get(key, &value);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    done = true;
+    scraper.join();
+
+    auto stats = cache.GetStats();
+    REQUIRE(stats.hits == kThreads * kKeys);
+    REQUIRE(stats.misses == kThreads * kKeys);
+    REQUIRE(stats.inserts == kThreads * kKeys);
+    REQUIRE(stats.evictions == 0u);
+}
@@ -0,0 +1,342 @@
+#include <catch.hpp>
+#include <string_view.h>
+#include <split.h>
+#include <rope.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+std::atomic<size_t> allocations_count = 0;
+
+void* operator new(size_t size) {
+    allocations_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+
+// StrSplit from move/string-operations, in its two allowed shapes: one vector
+// allocation up front, plus a copy of every field for the std::string one.
+template <class Str>
+std::vector<Str> StrSplit(std::string_view text, std::string_view delim) {
+    size_t count = 1;
+    for (size_t pos = text.find(delim); pos != text.npos; pos = text.find(delim, pos + delim.size())) {
+        ++count;
+    }
+    std::vector<Str> fields;
+    fields.reserve(count);
+    size_t begin = 0;
+    for (size_t end; (end = text.find(delim, begin)) != text.npos; begin = end + delim.size()) {
+        fields.emplace_back(text.substr(begin, end - begin));
+    }
+    fields.emplace_back(text.substr(begin));
+    return fields;
+}
+
+template <class F>
+double Milliseconds(F fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+// Lines of a protocol-like text with short fields, as the parsers see them.
+std::vector<std::string> MakeLines(size_t count, size_t length) {
+    std::mt19937 gen(34857);
+    std::uniform_int_distribution<int> letter('a', 'z');
+    std::vector<std::string> lines(count);
+    for (auto& line : lines) {
+        while (line.size() < length) {
+            line += "key_";
+            line += static_cast<char>(letter(gen));
+            line += '=';
+            for (int i = 0; i < 8; ++i) {
+                line += static_cast<char>(letter(gen));
+            }
+            line += ';';
+        }
+        line.resize(length);
+    }
+    return lines;
+}
+
+volatile size_t sink;
+
+// Prints the time std::string_view takes and then the time of each kernel level.
+template <class StdOp, class Op>
+void Report(const char* name, const std::vector<std::string>& lines,
+            const std::vector<std::string>& copies, size_t rounds, StdOp std_op, Op op) {
+    auto run = [&](auto fn) {
+        return Milliseconds([&] {
+            size_t total = 0;
+            for (size_t round = 0; round < rounds; ++round) {
+                for (size_t i = 0; i < lines.size(); ++i) {
+                    total += fn(lines[i], copies[i]);
+                }
+            }
+            sink = total;
+        });
+    };
+    std::cout << lines[0].size() << "\t" << name << "\t" << run(std_op);
+    for (auto level : {SimdLevel::kScalar, SimdLevel::kSse2, SimdLevel::kAvx2}) {
+        if (level <= DetectSimdLevel()) {
+            ForceSimdLevel(level);
+            std::cout << (level == SimdLevel::kScalar ? "\t" : "/") << run(op);
+        }
+    }
+    std::cout << "\n";
+}
+
+}  // namespace
+
+TEST_CASE("StringView operations throughput", "[benchmark]") {
+    const size_t kTotalBytes = 256 << 20;
+
+    std::cout << "line length\toperation\tstd::string_view, ms\tscalar/sse2/avx2, ms\n";
+    for (size_t length : {16, 64, 1024, 65536}) {
+        auto lines = MakeLines(std::max<size_t>(1, kTotalBytes / length / 16), length);
+        size_t rounds = kTotalBytes / (lines.size() * length);
+        auto copies = lines;
+
+        // The searched-for bytes never occur, so every operation scans whole lines.
+        using Line = const std::string&;
+        Report(
+            "Find(char)", lines, copies, rounds,
+            [](Line s, Line) { return std::string_view(s).find('#'); },
+            [](Line s, Line) { return StringView(s).Find('#'); });
+        Report(
+            "Find(str)", lines, copies, rounds,
+            [](Line s, Line) { return std::string_view(s).find("key_#="); },
+            [](Line s, Line) { return StringView(s).Find("key_#="); });
+        Report(
+            "FindFirstOf", lines, copies, rounds,
+            [](Line s, Line) { return std::string_view(s).find_first_of("\r\n\"\\"); },
+            [](Line s, Line) { return StringView(s).FindFirstOf("\r\n\"\\"); });
+        Report(
+            "Compare", lines, copies, rounds,
+            [](Line s, Line t) { return static_cast<size_t>(std::string_view(s).compare(t)); },
+            [](Line s, Line t) { return static_cast<size_t>(StringView(s).Compare(t)); });
+        Report(
+            "Hash", lines, copies, rounds,
+            [](Line s, Line) { return std::hash<std::string_view>()(s); },
+            [](Line s, Line) { return StringView(s).Hash(); });
+    }
+    ForceSimdLevel(DetectSimdLevel());
+}
+
+TEST_CASE("Split throughput", "[benchmark]") {
+    const size_t kLines = 2000000;
+
+    // CSV rows of 12 short fields and log lines of words separated by runs of spaces.
+    std::mt19937 gen(8345);
+    std::uniform_int_distribution<int> length(1, 12);
+    std::string csv;
+    std::string log;
+    for (size_t i = 0; i < kLines; ++i) {
+        for (int field = 0; field < 12; ++field) {
+            csv.append(length(gen), 'x');
+            csv += field + 1 < 12 ? ',' : '\n';
+            log.append(length(gen), 'y');
+            log.append(length(gen) % 3 + 1, ' ');
+        }
+        log += '\n';
+    }
+
+    std::cout << "input\tsplitter\tfields\tms\tMfields/s\tallocations\n";
+    auto report = [](const char* input, const char* name, auto count_fields) {
+        size_t allocations_before = allocations_count.load();
+        size_t fields = 0;
+        double ms = Milliseconds([&] { fields = count_fields(); });
+        std::cout << input << "\t" << name << "\t" << fields << "\t" << ms << "\t"
+                  << fields / ms / 1000 << "\t" << allocations_count.load() - allocations_before
+                  << "\n";
+    };
+
+    auto str_split = [&]<class Str>() {
+        size_t fields = 0;
+        for (const auto& line : StrSplit<std::string_view>(csv, "\n")) {
+            fields += StrSplit<Str>(line, ",").size();
+        }
+        return fields;
+    };
+    report("csv", "StrSplit -> vector<string>", [&] { return str_split.operator()<std::string>(); });
+    report("csv", "StrSplit -> vector<string_view>",
+           [&] { return str_split.operator()<std::string_view>(); });
+    report("csv", "Split", [&] {
+        size_t fields = 0;
+        for (StringView line : Split(csv, "\n")) {
+            for (StringView field : Split(line, ",")) {
+                fields += field.Data() != nullptr;
+            }
+        }
+        return fields;
+    });
+
+    report("log", "StrSplit(\" \") -> vector<string_view>", [&] {
+        size_t fields = 0;
+        for (const auto& line : StrSplit<std::string_view>(log, "\n")) {
+            for (const auto& field : StrSplit<std::string_view>(line, " ")) {
+                fields += !field.empty();
+            }
+        }
+        return fields;
+    });
+    report("log", "Tokenize(\" \\n\")", [&] {
+        size_t fields = 0;
+        for (StringView word : Tokenize(log, " \n")) {
+            fields += word.Size() > 0;
+        }
+        return fields;
+    });
+}
+
+TEST_CASE("Rope response assembly", "[benchmark]") {
+    const size_t kResponseBytes = 100 << 20;
+
+    // Fragments of a response: short header-like pieces and body pieces up to 8 KB,
+    // all slices of one source text.
+    std::mt19937 gen(5463);
+    std::string source(1 << 20, ' ');
+    for (auto& c : source) {
+        c = static_cast<char>(std::uniform_int_distribution<int>('a', 'z')(gen));
+    }
+    std::vector<StringView> fragments;
+    std::vector<std::string> rendered;
+    for (size_t total = 0; total < kResponseBytes;) {
+        size_t size = std::uniform_int_distribution<size_t>(0, 3)(gen) == 0
+                          ? std::uniform_int_distribution<size_t>(10, 60)(gen)
+                          : std::uniform_int_distribution<size_t>(100, 8000)(gen);
+        size_t pos = std::uniform_int_distribution<size_t>(0, source.size() - size)(gen);
+        fragments.emplace_back(source.data() + pos, size);
+        total += size;
+    }
+    for (auto fragment : fragments) {
+        rendered.emplace_back(fragment.Data(), fragment.Size());
+    }
+    Rope cached_block;
+    for (size_t i = 0; cached_block.Size() < (1 << 20); ++i) {
+        cached_block.Append(fragments[i]);
+    }
+
+    int dev_null = open("/dev/null", O_WRONLY);
+    REQUIRE(dev_null >= 0);
+    auto send_string = [dev_null](const std::string& response) {
+        for (size_t pos = 0; pos < response.size();) {
+            ssize_t written = write(dev_null, response.data() + pos, response.size() - pos);
+            REQUIRE(written > 0);
+            pos += written;
+        }
+    };
+
+    std::cout << fragments.size() << " fragments, " << kResponseBytes / (1 << 20)
+              << " MB\nscenario\tbuild, ms\tsend, ms\tchunks\tallocations\n";
+    auto report = [&](const char* name, auto build, auto send) {
+        size_t allocations_before = allocations_count.load();
+        decltype(build()) response;
+        double build_ms = Milliseconds([&] { response = build(); });
+        double send_ms = Milliseconds([&] { send(response); });
+        size_t chunks = 1;
+        if constexpr (std::is_same_v<decltype(response), Rope>) {
+            chunks = response.ChunksCount();
+        }
+        std::cout << name << "\t" << build_ms << "\t" << send_ms << "\t" << chunks << "\t"
+                  << allocations_count.load() - allocations_before << "\n";
+    };
+    auto send_rope = [dev_null](const Rope& response) { response.WriteTo(dev_null); };
+
+    report(
+        "string += views", [&] {
+            std::string response;
+            for (auto fragment : fragments) {
+                response.append(fragment.Data(), fragment.Size());
+            }
+            return response;
+        },
+        send_string);
+    report(
+        "string += views, reserved", [&] {
+            std::string response;
+            response.reserve(kResponseBytes + 8000);
+            for (auto fragment : fragments) {
+                response.append(fragment.Data(), fragment.Size());
+            }
+            return response;
+        },
+        send_string);
+    report(
+        "Rope::Append(view)", [&] {
+            Rope response;
+            for (auto fragment : fragments) {
+                response.Append(fragment);
+            }
+            return response;
+        },
+        send_rope);
+
+    // Pieces that were rendered into strings of their own.
+    auto moved = rendered;
+    report(
+        "string += strings", [&] {
+            std::string response;
+            for (const auto& piece : rendered) {
+                response += piece;
+            }
+            return response;
+        },
+        send_string);
+    report(
+        "Rope::Append(string&&)", [&] {
+            Rope response;
+            for (auto& piece : moved) {
+                response.Append(std::move(piece));
+            }
+            return response;
+        },
+        send_rope);
+
+    // The same cached 1 MB block repeated, as for a templated page.
+    report(
+        "string += cached block", [&] {
+            std::string response;
+            auto block = cached_block.ToString();
+            while (response.size() < kResponseBytes) {
+                response += block;
+            }
+            return response;
+        },
+        send_string);
+    report(
+        "Rope += cached block", [&] {
+            Rope response;
+            while (response.Size() < kResponseBytes) {
+                response += cached_block;
+            }
+            return response;
+        },
+        send_rope);
+    close(dev_null);
+}
@@ -0,0 +1,253 @@
+#include "rope.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+RopeBuffer::RopeBuffer(size_t capacity)
+    : block_(new char[capacity]), data_(block_.get()), capacity_(capacity), used_(0) {
+}
+
+RopeBuffer::RopeBuffer(std::string value)
+    : value_(std::move(value)),
+      data_(value_.data()),
+      capacity_(value_.size()),
+      used_(value_.size()) {
+}
+
+bool RopeBuffer::TryAppend(size_t end, StringView s) {
+    if (s.Size() > capacity_ - end ||
+        !used_.compare_exchange_strong(end, end + s.Size(), std::memory_order_relaxed)) {
+        return false;
+    }
+    std::memcpy(data_ + end, s.Data(), s.Size());
+    return true;
+}
+
+Rope::Rope(StringView s) {
+    Append(s);
+}
+
+Rope::Rope(std::string s) {
+    Append(std::move(s));
+}
+
+void Rope::Append(StringView s) {
+    if (s.Size() == 0) {
+        return;
+    }
+    if (tail_buffer_ && tail_buffer_->TryAppend(tail_begin_ + tail_size_, s)) {
+        tail_size_ += s.Size();
+        return;
+    }
+    // Buffers double up to kMaxBufferSize, so short ropes stay small.
+    size_t capacity = tail_buffer_ ? std::min(kMaxBufferSize, 2 * tail_buffer_->Capacity())
+                                   : kMinBufferSize;
+    FlushTail();
+    tail_buffer_ = std::make_shared<RopeBuffer>(std::max(capacity, s.Size()));
+    tail_buffer_->TryAppend(0, s);
+    tail_begin_ = 0;
+    tail_size_ = s.Size();
+}
+
+void Rope::Append(std::string s) {
+    if (s.empty()) {
+        return;
+    }
+    FlushTail();
+    auto buffer = std::make_shared<RopeBuffer>(std::move(s));
+    root_ = Join(root_, MakeLeaf(buffer, StringView(buffer->Data(), buffer->Capacity())));
+}
+
+void Rope::Append(const Rope& other) {
+    if (this == &other) {
+        Append(Rope(other));
+        return;
+    }
+    FlushTail();
+    root_ = Join(root_, other.root_);
+    // Keep growing the other rope's tail: the bytes after it are claimed by
+    // whoever appends there first, so sharing it is safe.
+    tail_buffer_ = other.tail_buffer_;
+    tail_begin_ = other.tail_begin_;
+    tail_size_ = other.tail_size_;
+}
+
+size_t Rope::Size() const {
+    return SizeOf(root_) + tail_size_;
+}
+
+char Rope::operator[](size_t i) const {
+    if (i >= Size()) {
+        throw std::runtime_error("index out of range");
+    }
+    if (i >= SizeOf(root_)) {
+        return tail_buffer_->Data()[tail_begin_ + i - SizeOf(root_)];
+    }
+    const Node* node = root_.get();
+    while (node->left) {
+        if (i < node->left->size) {
+            node = node->left.get();
+        } else {
+            i -= node->left->size;
+            node = node->right.get();
+        }
+    }
+    return node->slice.UncheckedAt(i);
+}
+
+Rope Rope::Substr(size_t pos, size_t count) const {
+    if (pos > Size()) {
+        throw std::runtime_error("index out of range");
+    }
+    count = std::min(count, Size() - pos);
+    Rope result;
+    if (count == 0) {
+        return result;
+    }
+    auto rest = Split(Tree(), pos).second;
+    result.root_ = Split(rest, count).first;
+    return result;
+}
+
+size_t Rope::ChunksCount() const {
+    size_t count = 0;
+    ForEachChunk([&count](StringView) { ++count; });
+    return count;
+}
+
+std::vector<iovec> Rope::Iovecs() const {
+    std::vector<iovec> iovecs;
+    iovecs.reserve(ChunksCount());
+    ForEachChunk([&iovecs](StringView chunk) {
+        iovecs.push_back({const_cast<char*>(chunk.Data()), chunk.Size()});
+    });
+    return iovecs;
+}
+
+void Rope::WriteTo(int fd) const {
+    auto iovecs = Iovecs();
+    auto* iov = iovecs.data();
+    auto* end = iov + iovecs.size();
+    while (iov != end) {
+        int count = static_cast<int>(std::min<ptrdiff_t>(end - iov, IOV_MAX));
+        ssize_t written = writev(fd, iov, count);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error(std::string("Rope: writev failed: ") + std::strerror(errno));
+        }
+        // Skip what was written, the first iovec left may be cut in the middle.
+        auto left = static_cast<size_t>(written);
+        while (iov != end && left >= iov->iov_len) {
+            left -= iov->iov_len;
+            ++iov;
+        }
+        if (left > 0) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + left;
+            iov->iov_len -= left;
+        }
+    }
+}
+
+std::string Rope::ToString() const {
+    std::string result;
+    result.reserve(Size());
+    ForEachChunk([&result](StringView chunk) { result.append(chunk.Data(), chunk.Size()); });
+    return result;
+}
+
+Rope::NodePtr Rope::MakeLeaf(std::shared_ptr<RopeBuffer> buffer, StringView slice) {
+    return std::make_shared<const Node>(
+        Node{nullptr, nullptr, std::move(buffer), slice, slice.Size(), 0});
+}
+
+Rope::NodePtr Rope::MakeConcat(NodePtr left, NodePtr right) {
+    size_t size = left->size + right->size;
+    int height = std::max(left->height, right->height) + 1;
+    return std::make_shared<const Node>(
+        Node{std::move(left), std::move(right), nullptr, StringView("", 0), size, height});
+}
+
+size_t Rope::SizeOf(const NodePtr& node) {
+    return node ? node->size : 0;
+}
+
+// Concatenates two balanced trees whose heights differ by at most 2 with one
+// single or double rotation, as AVL insertion does.
+Rope::NodePtr Rope::Balance(NodePtr left, NodePtr right) {
+    if (left->height > right->height + 1) {
+        const auto& inner = left->right;
+        if (left->left->height >= inner->height) {
+            return MakeConcat(left->left, MakeConcat(inner, std::move(right)));
+        }
+        return MakeConcat(MakeConcat(left->left, inner->left),
+                          MakeConcat(inner->right, std::move(right)));
+    }
+    if (right->height > left->height + 1) {
+        const auto& inner = right->left;
+        if (right->right->height >= inner->height) {
+            return MakeConcat(MakeConcat(std::move(left), inner), right->right);
+        }
+        return MakeConcat(MakeConcat(std::move(left), inner->left),
+                          MakeConcat(inner->right, right->right));
+    }
+    return MakeConcat(std::move(left), std::move(right));
+}
+
+// Walks down the spine of the taller tree to the height of the shorter one, so it
+// takes O(height difference) new nodes.
+Rope::NodePtr Rope::Join(NodePtr left, NodePtr right) {
+    if (!left) {
+        return right;
+    }
+    if (!right) {
+        return left;
+    }
+    if (left->height > right->height + 1) {
+        return Balance(left->left, Join(left->right, std::move(right)));
+    }
+    if (right->height > left->height + 1) {
+        return Balance(Join(std::move(left), right->left), right->right);
+    }
+    return MakeConcat(std::move(left), std::move(right));
+}
+
+std::pair<Rope::NodePtr, Rope::NodePtr> Rope::Split(const NodePtr& node, size_t pos) {
+    if (pos == 0) {
+        return {nullptr, node};
+    }
+    if (pos >= node->size) {
+        return {node, nullptr};
+    }
+    if (!node->left) {
+        return {MakeLeaf(node->buffer, node->slice.Substr(0, pos)),
+                MakeLeaf(node->buffer, node->slice.Substr(pos))};
+    }
+    if (pos <= node->left->size) {
+        auto [left, right] = Split(node->left, pos);
+        return {std::move(left), Join(std::move(right), node->right)};
+    }
+    auto [left, right] = Split(node->right, pos - node->left->size);
+    return {Join(node->left, std::move(left)), std::move(right)};
+}
+
+Rope::NodePtr Rope::Tree() const {
+    if (tail_size_ == 0) {
+        return root_;
+    }
+    return Join(root_, MakeLeaf(tail_buffer_, StringView(tail_buffer_->Data() + tail_begin_,
+                                                         tail_size_)));
+}
+
+void Rope::FlushTail() {
+    root_ = Tree();
+    tail_begin_ += tail_size_;
+    tail_size_ = 0;
+}
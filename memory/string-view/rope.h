@@ -0,0 +1,149 @@
+#pragma once
+
+#include "string_view.h"
+
+#include <sys/uio.h>
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Storage the slices of a Rope point into: either a string handed over whole, or a
+// block that Append(StringView) fills front to back. Bytes once written never
+// change, so any number of ropes can share a buffer.
+class RopeBuffer {
+public:
+    explicit RopeBuffer(size_t capacity);
+    explicit RopeBuffer(std::string value);
+
+    RopeBuffer(const RopeBuffer&) = delete;
+    RopeBuffer& operator=(const RopeBuffer&) = delete;
+
+    const char* Data() const {
+        return data_;
+    }
+    size_t Capacity() const {
+        return capacity_;
+    }
+
+    // Copies s to position end if nobody has written past end yet and it fits.
+    // Two ropes sharing the buffer cannot both claim the same bytes.
+    bool TryAppend(size_t end, StringView s);
+
+private:
+    std::string value_;
+    std::unique_ptr<char[]> block_;
+    char* data_;
+    size_t capacity_;
+    std::atomic<size_t> used_;
+};
+
+// A string assembled from slices of refcounted buffers without flattening it. The
+// slices are leaves of a persistent AVL tree, so copies share structure and
+// concatenation, Substr and indexing take O(log n) in the number of slices.
+// Small appends are copied into buffers of up to 64 KB and grow the last slice in
+// place.
+class Rope {
+public:
+    static constexpr size_t kNpos = StringView::kNpos;
+
+    Rope() = default;
+    explicit Rope(StringView s);
+    explicit Rope(const char* s) : Rope(StringView(s)) {
+    }
+    // Takes the string as one slice, without copying the bytes.
+    explicit Rope(std::string s);
+
+    // Copies the bytes: the view does not keep them alive.
+    void Append(StringView s);
+    void Append(const char* s) {
+        Append(StringView(s));
+    }
+    void Append(std::string s);
+    void Append(const Rope& other);
+
+    Rope& operator+=(const Rope& other) {
+        Append(other);
+        return *this;
+    }
+    friend Rope operator+(Rope lhs, const Rope& rhs) {
+        lhs.Append(rhs);
+        return lhs;
+    }
+
+    size_t Size() const;
+    char operator[](size_t i) const;
+
+    // Throws if pos > Size(), clips count.
+    Rope Substr(size_t pos, size_t count = kNpos) const;
+
+    // Calls fn(StringView) for every contiguous chunk, in order.
+    template <class F>
+    void ForEachChunk(F fn) const;
+    size_t ChunksCount() const;
+
+    // One iovec per chunk, valid while this rope (or a copy) lives.
+    std::vector<iovec> Iovecs() const;
+    // Writes the whole rope with writev, retrying partial writes.
+    void WriteTo(int fd) const;
+
+    std::string ToString() const;
+
+private:
+    struct Node;
+    using NodePtr = std::shared_ptr<const Node>;
+
+    static NodePtr MakeLeaf(std::shared_ptr<RopeBuffer> buffer, StringView slice);
+    static NodePtr MakeConcat(NodePtr left, NodePtr right);
+    static NodePtr Balance(NodePtr left, NodePtr right);
+    static NodePtr Join(NodePtr left, NodePtr right);
+    static std::pair<NodePtr, NodePtr> Split(const NodePtr& node, size_t pos);
+    static size_t SizeOf(const NodePtr& node);
+
+    template <class F>
+    static void ForEachLeaf(const Node* node, F& fn);
+
+    // The tree with the tail joined in.
+    NodePtr Tree() const;
+    void FlushTail();
+
+    static constexpr size_t kMinBufferSize = 256;
+    static constexpr size_t kMaxBufferSize = 64 << 10;
+
+    NodePtr root_;
+    // The last slice, kept out of the tree while appends keep growing it.
+    std::shared_ptr<RopeBuffer> tail_buffer_;
+    size_t tail_begin_ = 0;
+    size_t tail_size_ = 0;
+};
+
+struct Rope::Node {
+    // Leaves hold a slice and no children; inner nodes are the other way round.
+    NodePtr left;
+    NodePtr right;
+    std::shared_ptr<RopeBuffer> buffer;
+    StringView slice{"", 0};
+    size_t size;
+    int height;
+};
+
+template <class F>
+void Rope::ForEachLeaf(const Node* node, F& fn) {
+    while (node->left) {
+        ForEachLeaf(node->left.get(), fn);
+        node = node->right.get();
+    }
+    fn(node->slice);
+}
+
+template <class F>
+void Rope::ForEachChunk(F fn) const {
+    if (root_) {
+        ForEachLeaf(root_.get(), fn);
+    }
+    if (tail_size_ > 0) {
+        fn(StringView(tail_buffer_->Data() + tail_begin_, tail_size_));
+    }
+}
@@ -0,0 +1,224 @@
+#pragma once
+
+#include "string_view.h"
+
+#include <algorithm>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <utility>
+
+// Lazy ranges of the fields of a string. They yield StringViews into the original
+// buffer and never allocate; the text (and the range, which its iterators point
+// to) must outlive the iteration.
+
+// Fields between occurrences of delim, as StrSplit gives them: empty fields are
+// kept, so "" has one field and "a," has two. An empty delim yields the whole
+// text as one field.
+class SplitRange {
+public:
+    class Iterator {
+    public:
+        using value_type = StringView;
+        using difference_type = std::ptrdiff_t;
+        using iterator_concept = std::forward_iterator_tag;
+
+        Iterator() = default;
+
+        StringView operator*() const {
+            return range_->text_.Substr(begin_, end_ - begin_);
+        }
+
+        Iterator& operator++() {
+            if (end_ == range_->text_.Size()) {
+                begin_ = StringView::kNpos;
+            } else {
+                begin_ = end_ + range_->delim_.Size();
+                end_ = range_->FieldEnd(begin_);
+            }
+            return *this;
+        }
+        Iterator operator++(int) {
+            auto old = *this;
+            ++*this;
+            return old;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return begin_ == other.begin_;
+        }
+        bool operator==(std::default_sentinel_t) const {
+            return begin_ == StringView::kNpos;
+        }
+
+    private:
+        friend class SplitRange;
+
+        Iterator(const SplitRange* range, size_t begin)
+            : range_(range), begin_(begin), end_(range->FieldEnd(begin)) {
+        }
+
+        const SplitRange* range_ = nullptr;
+        size_t begin_ = StringView::kNpos;
+        size_t end_ = StringView::kNpos;
+    };
+
+    SplitRange(StringView text, StringView delim) : text_(text), delim_(delim) {
+    }
+
+    Iterator begin() const {
+        return Iterator(this, 0);
+    }
+    std::default_sentinel_t end() const {
+        return std::default_sentinel;
+    }
+
+private:
+    size_t FieldEnd(size_t begin) const {
+        size_t end = delim_.Size() == 0 ? StringView::kNpos : text_.Find(delim_, begin);
+        return end == StringView::kNpos ? text_.Size() : end;
+    }
+
+    StringView text_;
+    StringView delim_;
+};
+
+inline SplitRange Split(StringView text, StringView delim) {
+    return SplitRange(text, delim);
+}
+
+// Byte set for Tokenize, built once from the characters of a string.
+class CharSet {
+public:
+    CharSet(StringView chars) {
+        for (size_t i = 0; i < chars.Size(); ++i) {
+            auto c = static_cast<unsigned char>(chars.UncheckedAt(i));
+            bits_[c / 64] |= uint64_t{1} << (c % 64);
+        }
+    }
+
+    bool operator()(char c) const {
+        auto u = static_cast<unsigned char>(c);
+        return (bits_[u / 64] >> (u % 64)) & 1;
+    }
+
+private:
+    uint64_t bits_[4] = {};
+};
+
+// Maximal non-empty runs of characters for which is_separator is false, like
+// strtok: separators at the ends and in a row produce no empty tokens.
+template <class Pred>
+class TokenizeRange {
+public:
+    class Iterator {
+    public:
+        using value_type = StringView;
+        using difference_type = std::ptrdiff_t;
+        using iterator_concept = std::forward_iterator_tag;
+
+        Iterator() = default;
+
+        StringView operator*() const {
+            return range_->text_.Substr(begin_, end_ - begin_);
+        }
+
+        Iterator& operator++() {
+            Seek(end_);
+            return *this;
+        }
+        Iterator operator++(int) {
+            auto old = *this;
+            ++*this;
+            return old;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return begin_ == other.begin_;
+        }
+        bool operator==(std::default_sentinel_t) const {
+            return range_ == nullptr || begin_ == range_->text_.Size();
+        }
+
+    private:
+        friend class TokenizeRange;
+
+        Iterator(const TokenizeRange* range, size_t pos) : range_(range) {
+            Seek(pos);
+        }
+
+        // Tokens are found in a bitmask of the separators among 64 bytes, so a
+        // token costs a couple of bit scans instead of a mispredicted branch per
+        // token boundary.
+        void Seek(size_t pos) {
+            size_t size = range_->text_.Size();
+            begin_ = NextWhere(pos, false);
+            end_ = begin_ == size ? size : NextWhere(begin_, true);
+        }
+
+        // The first position at or after pos that is a separator or not, as
+        // is_separator says, or the text size. Bytes past the end count as
+        // separators.
+        size_t NextWhere(size_t pos, bool is_separator) {
+            size_t size = range_->text_.Size();
+            while (pos < size) {
+                if (pos < block_ || pos - block_ >= 64) {
+                    LoadBlock(pos);
+                }
+                uint64_t wanted = (is_separator ? separators_ : ~separators_) >> (pos - block_);
+                if (wanted != 0) {
+                    return pos + std::countr_zero(wanted);
+                }
+                pos = block_ + 64;
+            }
+            return size;
+        }
+
+        void LoadBlock(size_t block) {
+            const auto& text = range_->text_;
+            const auto& is_separator = range_->is_separator_;
+            size_t count = std::min<size_t>(64, text.Size() - block);
+            uint64_t separators = count == 64 ? 0 : ~uint64_t{0} << count;
+            for (size_t i = 0; i < count; ++i) {
+                uint64_t bit = is_separator(text.UncheckedAt(block + i)) ? 1 : 0;
+                separators |= bit << i;
+            }
+            block_ = block;
+            separators_ = separators;
+        }
+
+        const TokenizeRange* range_ = nullptr;
+        size_t begin_ = 0;
+        size_t end_ = 0;
+        // Start of the 64 bytes in separators_, kNpos before the first load.
+        size_t block_ = StringView::kNpos;
+        uint64_t separators_ = 0;
+    };
+
+    TokenizeRange(StringView text, Pred is_separator)
+        : text_(text), is_separator_(std::move(is_separator)) {
+    }
+
+    Iterator begin() const {
+        return Iterator(this, 0);
+    }
+    std::default_sentinel_t end() const {
+        return std::default_sentinel;
+    }
+
+private:
+    StringView text_;
+    Pred is_separator_;
+};
+
+template <class Pred>
+    requires std::predicate<const Pred&, char>
+TokenizeRange<Pred> Tokenize(StringView text, Pred is_separator) {
+    return TokenizeRange<Pred>(text, std::move(is_separator));
+}
+
+inline TokenizeRange<CharSet> Tokenize(StringView text, StringView separators) {
+    return TokenizeRange<CharSet>(text, CharSet(separators));
+}
@@ -0,0 +1,416 @@
+#include "string_view.h"
+
+#ifdef STRING_VIEW_CHECK_LIFETIME
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#define STRING_VIEW_X86 1
+#include <immintrin.h>
+#endif
+
+namespace string_view_internal {
+namespace {
+
+// All kernels return the position of the first match, or n if there is none.
+// Finds get 1 <= m <= n and k >= 1 from the StringView methods.
+
+uint64_t Load64(const char* s) {
+    uint64_t word;
+    std::memcpy(&word, s, sizeof(word));
+    return word;
+}
+
+uint64_t LoadTail(const char* s, size_t n) {
+    uint64_t word = 0;
+    std::memcpy(&word, s, n);
+    return word;
+}
+
+size_t ScalarFindChar(const char* s, size_t n, char c) {
+    for (size_t i = 0; i < n; ++i) {
+        if (s[i] == c) {
+            return i;
+        }
+    }
+    return n;
+}
+
+size_t ScalarFind(const char* s, size_t n, const char* needle, size_t m) {
+    for (size_t i = 0; i + m <= n; ++i) {
+        if (s[i] == needle[0] && s[i + m - 1] == needle[m - 1] &&
+            std::memcmp(s + i + 1, needle + 1, m - 1) == 0) {
+            return i;
+        }
+    }
+    return n;
+}
+
+size_t ScalarFindFirstOf(const char* s, size_t n, const char* chars, size_t k) {
+    bool is_wanted[256] = {};
+    for (size_t j = 0; j < k; ++j) {
+        is_wanted[static_cast<unsigned char>(chars[j])] = true;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        if (is_wanted[static_cast<unsigned char>(s[i])]) {
+            return i;
+        }
+    }
+    return n;
+}
+
+size_t ScalarMismatch(const char* a, const char* b, size_t n) {
+    size_t i = 0;
+    while (i + 8 <= n && Load64(a + i) == Load64(b + i)) {
+        i += 8;
+    }
+    while (i < n && a[i] == b[i]) {
+        ++i;
+    }
+    return i;
+}
+
+#ifdef STRING_VIEW_X86
+
+// SSE2 is part of x86-64, so these need no target attribute. Every loop handles
+// whole vectors only and leaves the tail to the narrower kernel, so nothing is
+// read past the end of the view.
+
+__m128i Load128(const char* s) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+}
+
+size_t Sse2FindChar(const char* s, size_t n, char c) {
+    __m128i pattern = _mm_set1_epi8(c);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(Load128(s + i), pattern));
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i + ScalarFindChar(s + i, n - i, c);
+}
+
+// Compares the first and the last needle byte at 16 positions at once and checks
+// the whole needle only where both match.
+size_t Sse2Find(const char* s, size_t n, const char* needle, size_t m) {
+    if (m == 1) {
+        return Sse2FindChar(s, n, needle[0]);
+    }
+    __m128i first = _mm_set1_epi8(needle[0]);
+    __m128i last = _mm_set1_epi8(needle[m - 1]);
+    size_t i = 0;
+    for (; i + m - 1 + 16 <= n; i += 16) {
+        __m128i match = _mm_and_si128(_mm_cmpeq_epi8(Load128(s + i), first),
+                                      _mm_cmpeq_epi8(Load128(s + i + m - 1), last));
+        for (int mask = _mm_movemask_epi8(match); mask != 0; mask &= mask - 1) {
+            size_t pos = i + __builtin_ctz(mask);
+            if (std::memcmp(s + pos + 1, needle + 1, m - 2) == 0) {
+                return pos;
+            }
+        }
+    }
+    return i + m <= n ? i + ScalarFind(s + i, n - i, needle, m) : n;
+}
+
+size_t Sse2FindFirstOf(const char* s, size_t n, const char* chars, size_t k) {
+    if (k > 16) {
+        return ScalarFindFirstOf(s, n, chars, k);
+    }
+    __m128i patterns[16];
+    for (size_t j = 0; j < k; ++j) {
+        patterns[j] = _mm_set1_epi8(chars[j]);
+    }
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i chunk = Load128(s + i);
+        __m128i match = _mm_cmpeq_epi8(chunk, patterns[0]);
+        for (size_t j = 1; j < k; ++j) {
+            match = _mm_or_si128(match, _mm_cmpeq_epi8(chunk, patterns[j]));
+        }
+        int mask = _mm_movemask_epi8(match);
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i + ScalarFindFirstOf(s + i, n - i, chars, k);
+}
+
+size_t Sse2Mismatch(const char* a, const char* b, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(Load128(a + i), Load128(b + i)));
+        if (mask != 0xFFFF) {
+            return i + __builtin_ctz(~mask);
+        }
+    }
+    return i + ScalarMismatch(a + i, b + i, n - i);
+}
+
+// The tails go to the SSE2 kernels, which are compiled without VEX encoding.
+// Mixing the two while the upper halves of ymm registers are dirty costs a
+// state transition on every instruction on some CPUs, so clear them first.
+#define STRING_VIEW_AVX2 __attribute__((target("avx2")))
+
+STRING_VIEW_AVX2 __m256i Load256(const char* s) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s));
+}
+
+STRING_VIEW_AVX2 uint32_t EqualMask(__m256i a, __m256i b) {
+    return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)));
+}
+
+STRING_VIEW_AVX2 size_t Avx2FindChar(const char* s, size_t n, char c) {
+    __m256i pattern = _mm256_set1_epi8(c);
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        uint32_t mask = EqualMask(Load256(s + i), pattern);
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    _mm256_zeroupper();
+    return i + Sse2FindChar(s + i, n - i, c);
+}
+
+STRING_VIEW_AVX2 size_t Avx2Find(const char* s, size_t n, const char* needle, size_t m) {
+    if (m == 1) {
+        return Avx2FindChar(s, n, needle[0]);
+    }
+    __m256i first = _mm256_set1_epi8(needle[0]);
+    __m256i last = _mm256_set1_epi8(needle[m - 1]);
+    size_t i = 0;
+    for (; i + m - 1 + 32 <= n; i += 32) {
+        uint32_t mask =
+            EqualMask(Load256(s + i), first) & EqualMask(Load256(s + i + m - 1), last);
+        for (; mask != 0; mask &= mask - 1) {
+            size_t pos = i + __builtin_ctz(mask);
+            if (std::memcmp(s + pos + 1, needle + 1, m - 2) == 0) {
+                return pos;
+            }
+        }
+    }
+    _mm256_zeroupper();
+    return i + m <= n ? i + Sse2Find(s + i, n - i, needle, m) : n;
+}
+
+STRING_VIEW_AVX2 size_t Avx2FindFirstOf(const char* s, size_t n, const char* chars, size_t k) {
+    if (k > 16) {
+        return ScalarFindFirstOf(s, n, chars, k);
+    }
+    __m256i patterns[16];
+    for (size_t j = 0; j < k; ++j) {
+        patterns[j] = _mm256_set1_epi8(chars[j]);
+    }
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i chunk = Load256(s + i);
+        __m256i match = _mm256_cmpeq_epi8(chunk, patterns[0]);
+        for (size_t j = 1; j < k; ++j) {
+            match = _mm256_or_si256(match, _mm256_cmpeq_epi8(chunk, patterns[j]));
+        }
+        uint32_t mask = _mm256_movemask_epi8(match);
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    _mm256_zeroupper();
+    return i + Sse2FindFirstOf(s + i, n - i, chars, k);
+}
+
+STRING_VIEW_AVX2 size_t Avx2Mismatch(const char* a, const char* b, size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        uint32_t mask = EqualMask(Load256(a + i), Load256(b + i));
+        if (mask != 0xFFFFFFFF) {
+            return i + __builtin_ctz(~mask);
+        }
+    }
+    _mm256_zeroupper();
+    return i + Sse2Mismatch(a + i, b + i, n - i);
+}
+
+#undef STRING_VIEW_AVX2
+
+#endif
+
+constexpr Kernels kScalarKernels{ScalarFindChar, ScalarFind, ScalarFindFirstOf, ScalarMismatch};
+#ifdef STRING_VIEW_X86
+constexpr Kernels kSse2Kernels{Sse2FindChar, Sse2Find, Sse2FindFirstOf, Sse2Mismatch};
+constexpr Kernels kAvx2Kernels{Avx2FindChar, Avx2Find, Avx2FindFirstOf, Avx2Mismatch};
+#endif
+
+const Kernels& KernelsFor(SimdLevel level) {
+    switch (level) {
+#ifdef STRING_VIEW_X86
+        case SimdLevel::kAvx2:
+            return kAvx2Kernels;
+        case SimdLevel::kSse2:
+            return kSse2Kernels;
+#endif
+        default:
+            return kScalarKernels;
+    }
+}
+
+const Kernels& Resolve() {
+    const Kernels* kernels = &KernelsFor(DetectSimdLevel());
+    active_kernels.store(kernels, std::memory_order_relaxed);
+    return *kernels;
+}
+
+size_t ResolveFindChar(const char* s, size_t n, char c) {
+    return Resolve().find_char(s, n, c);
+}
+
+size_t ResolveFind(const char* s, size_t n, const char* needle, size_t m) {
+    return Resolve().find(s, n, needle, m);
+}
+
+size_t ResolveFindFirstOf(const char* s, size_t n, const char* chars, size_t k) {
+    return Resolve().find_first_of(s, n, chars, k);
+}
+
+size_t ResolveMismatch(const char* a, const char* b, size_t n) {
+    return Resolve().mismatch(a, b, n);
+}
+
+constexpr Kernels kResolvingKernels{ResolveFindChar, ResolveFind, ResolveFindFirstOf,
+                                    ResolveMismatch};
+
+uint64_t Mix(uint64_t a, uint64_t b) {
+    unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+    return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+}
+
+}  // namespace
+
+std::atomic<const Kernels*> active_kernels{&kResolvingKernels};
+
+// Multiply-fold over 16-byte blocks, the same mixing step wyhash uses.
+uint64_t Hash(const char* s, size_t n) {
+    constexpr uint64_t kSeed = 0xa0761d6478bd642full;
+    constexpr uint64_t kPrime1 = 0xe7037ed1a0b428dbull;
+    constexpr uint64_t kPrime2 = 0x8ebc6af09c88c6e3ull;
+    uint64_t h = kSeed ^ n;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        h = Mix(Load64(s + i) ^ kPrime1, Load64(s + i + 8) ^ h);
+    }
+    uint64_t a;
+    uint64_t b = 0;
+    if (n - i >= 8) {
+        a = Load64(s + i);
+        b = LoadTail(s + i + 8, n - i - 8);
+    } else {
+        a = LoadTail(s + i, n - i);
+    }
+    return Mix(Mix(a ^ kPrime1, b ^ h), n ^ kPrime2);
+}
+
+#ifdef STRING_VIEW_CHECK_LIFETIME
+
+namespace {
+
+// Counters come in chunks that are never freed and go back to a free list when
+// their string dies, bumped, so a recycled counter never matches an old view.
+class LifetimeRegistry {
+public:
+    Lifetime* Acquire() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (free_.empty()) {
+            auto* chunk = new Lifetime[kChunkSize]();
+            chunks_.push_back(chunk);
+            for (size_t i = 0; i < kChunkSize; ++i) {
+                free_.push_back(chunk + i);
+            }
+        }
+        auto* lifetime = free_.back();
+        free_.pop_back();
+        return lifetime;
+    }
+
+    void Release(Lifetime* lifetime) {
+        lifetime->fetch_add(1, std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_.push_back(lifetime);
+    }
+
+private:
+    static constexpr size_t kChunkSize = 1024;
+
+    std::mutex mutex_;
+    std::vector<Lifetime*> chunks_;
+    std::vector<Lifetime*> free_;
+};
+
+// Leaked on purpose: strings with static storage may die after any destructor here.
+LifetimeRegistry& Registry() {
+    static auto* registry = new LifetimeRegistry;
+    return *registry;
+}
+
+void AbortOnDanglingView(const char* message) {
+    std::fprintf(stderr, "%s\n", message);
+    std::abort();
+}
+
+std::atomic<DanglingViewHandler> dangling_view_handler{AbortOnDanglingView};
+
+}  // namespace
+
+Lifetime* AcquireLifetime() {
+    return Registry().Acquire();
+}
+
+void ReleaseLifetime(Lifetime* lifetime) {
+    Registry().Release(lifetime);
+}
+
+void ReportDanglingView() {
+    dangling_view_handler.load()(
+        "StringView accessed after its TrackedString was destroyed or modified");
+    std::abort();
+}
+
+#endif
+
+}  // namespace string_view_internal
+
+#ifdef STRING_VIEW_CHECK_LIFETIME
+DanglingViewHandler SetDanglingViewHandler(DanglingViewHandler handler) {
+    return string_view_internal::dangling_view_handler.exchange(handler);
+}
+#endif
+
+SimdLevel DetectSimdLevel() {
+#ifdef STRING_VIEW_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return SimdLevel::kAvx2;
+    }
+    return SimdLevel::kSse2;
+#else
+    return SimdLevel::kScalar;
+#endif
+}
+
+SimdLevel ActiveSimdLevel() {
+    const auto* kernels = &string_view_internal::ActiveKernels();
+    for (auto level : {SimdLevel::kScalar, SimdLevel::kSse2, SimdLevel::kAvx2}) {
+        if (kernels == &string_view_internal::KernelsFor(level)) {
+            return level;
+        }
+    }
+    return DetectSimdLevel();
+}
+
+void ForceSimdLevel(SimdLevel level) {
+    level = std::min(level, DetectSimdLevel());
+    string_view_internal::active_kernels.store(&string_view_internal::KernelsFor(level),
+                                               std::memory_order_relaxed);
+}
@@ -1,44 +1,292 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <string>
 #include <cstring>
 #include <iostream>
+#include <stdexcept>
+#include <utility>
+
+// Define STRING_VIEW_CHECK_LIFETIME in every translation unit of a debug build to
+// catch views that outlive their TrackedString. Without it views stay a pointer
+// and a size, and the checks compile to nothing.
+
+class TrackedString;
+
+namespace string_view_internal {
+
+// Generation counter of a tracked buffer. The counters are never freed, so a view
+// can read its counter after the buffer is gone.
+using Lifetime = std::atomic<uint64_t>;
+
+#ifdef STRING_VIEW_CHECK_LIFETIME
+Lifetime* AcquireLifetime();
+void ReleaseLifetime(Lifetime* lifetime);
+[[noreturn]] void ReportDanglingView();
+#endif
+
+}  // namespace string_view_internal
 
 class StringView {
 public:
+    static constexpr size_t kNpos = static_cast<size_t>(-1);
+
     StringView(const std::string& s, size_t begin, size_t end);
+    StringView(const TrackedString& s, size_t begin = 0, size_t end = std::string::npos);
     StringView(const char* s);
     StringView(const char* s, size_t size);
     const char& operator[](size_t i) const;
     size_t Size() const;
 
+    // No bounds check, for inner loops that have already checked i < Size().
+    const char& UncheckedAt(size_t i) const {
+        CheckAlive();
+        return begin_[i];
+    }
+    const char* Data() const {
+        CheckAlive();
+        return begin_;
+    }
+
+    // Throws if pos > Size(), clips count like the std::string constructor does.
+    StringView Substr(size_t pos, size_t count = kNpos) const;
+
+    // Positions of the first match at or after pos, or kNpos.
+    size_t Find(char c, size_t pos = 0) const;
+    size_t Find(StringView needle, size_t pos = 0) const;
+    size_t FindFirstOf(StringView chars, size_t pos = 0) const;
+
+    // Lexicographic comparison by unsigned char: negative, zero or positive.
+    int Compare(StringView other) const;
+    bool StartsWith(StringView prefix) const;
+    bool operator==(StringView other) const;
+
+    // Fast non-cryptographic hash of the contents.
+    size_t Hash() const;
+
 private:
+    void CheckAlive() const {
+#ifdef STRING_VIEW_CHECK_LIFETIME
+        if (lifetime_ && lifetime_->load(std::memory_order_relaxed) != generation_) {
+            string_view_internal::ReportDanglingView();
+        }
+#endif
+    }
+
     size_t size_ = 0;
     const char* begin_;
+#ifdef STRING_VIEW_CHECK_LIFETIME
+    const string_view_internal::Lifetime* lifetime_ = nullptr;
+    uint64_t generation_ = 0;
+#endif
 };
 
-StringView::StringView(const std::string& s, size_t begin = 0, size_t end = std::string::npos) {
+// A string that views can check they do not outlive. In lifetime-checking builds
+// destroying it, moving from it or calling Mutable() bumps its generation, and
+// any later access through an older view goes to the dangling view handler. In
+// other builds it is just the std::string.
+class TrackedString {
+public:
+    TrackedString() = default;
+    explicit TrackedString(std::string value) : value_(std::move(value)) {
+    }
+
+    TrackedString(const TrackedString& other) : value_(other.value_) {
+    }
+    TrackedString(TrackedString&& other) : value_(std::move(other.Mutable())) {
+    }
+    TrackedString& operator=(const TrackedString& other) {
+        Mutable() = other.value_;
+        return *this;
+    }
+    TrackedString& operator=(TrackedString&& other) {
+        if (this != &other) {
+            Mutable() = std::move(other.Mutable());
+        }
+        return *this;
+    }
+
+    ~TrackedString() {
+#ifdef STRING_VIEW_CHECK_LIFETIME
+        string_view_internal::ReleaseLifetime(lifetime_);
+#endif
+    }
+
+    const std::string& Str() const {
+        return value_;
+    }
+
+    // The string may reallocate through the reference, so views taken before are invalid.
+    std::string& Mutable() {
+#ifdef STRING_VIEW_CHECK_LIFETIME
+        lifetime_->fetch_add(1, std::memory_order_relaxed);
+#endif
+        return value_;
+    }
+
+private:
+    friend class StringView;
+
+    std::string value_;
+#ifdef STRING_VIEW_CHECK_LIFETIME
+    string_view_internal::Lifetime* lifetime_ = string_view_internal::AcquireLifetime();
+#endif
+};
+
+#ifdef STRING_VIEW_CHECK_LIFETIME
+// Called with a description of the dangling access. The default handler prints it
+// and aborts; a handler may also throw. Returns the previous handler.
+using DanglingViewHandler = void (*)(const char* message);
+DanglingViewHandler SetDanglingViewHandler(DanglingViewHandler handler);
+#endif
+
+struct StringViewHash {
+    size_t operator()(StringView s) const {
+        return s.Hash();
+    }
+};
+
+// Kernels behind the search and compare methods. The widest level the CPU supports
+// is picked on first use; tests and benchmarks can force a narrower one.
+enum class SimdLevel { kScalar, kSse2, kAvx2 };
+
+SimdLevel DetectSimdLevel();
+SimdLevel ActiveSimdLevel();
+// Switches the kernels for all threads. Levels the CPU lacks fall back to the detected one.
+void ForceSimdLevel(SimdLevel level);
+
+namespace string_view_internal {
+
+struct Kernels {
+    size_t (*find_char)(const char* s, size_t n, char c);
+    size_t (*find)(const char* s, size_t n, const char* needle, size_t m);
+    size_t (*find_first_of)(const char* s, size_t n, const char* chars, size_t k);
+    size_t (*mismatch)(const char* a, const char* b, size_t n);
+};
+
+// Starts out as kernels that detect the CPU and swap in the real ones on first call,
+// so views searched during static initialization work too.
+extern std::atomic<const Kernels*> active_kernels;
+
+inline const Kernels& ActiveKernels() {
+    return *active_kernels.load(std::memory_order_relaxed);
+}
+
+uint64_t Hash(const char* s, size_t n);
+
+}  // namespace string_view_internal
+
+inline StringView::StringView(const std::string& s, size_t begin = 0,
+                              size_t end = std::string::npos) {
     begin_ = s.c_str() + begin;
     size_ = std::min(end, s.size() - begin);
 }
 
-StringView::StringView(const char* s) {
+inline StringView::StringView(const TrackedString& s, size_t begin, size_t end)
+    : StringView(s.value_, begin, end) {
+#ifdef STRING_VIEW_CHECK_LIFETIME
+    lifetime_ = s.lifetime_;
+    generation_ = lifetime_->load(std::memory_order_relaxed);
+#endif
+}
+
+inline StringView::StringView(const char* s) {
     begin_ = s;
     size_ = std::strlen(s);
 }
 
-StringView::StringView(const char* s, size_t size) {
+inline StringView::StringView(const char* s, size_t size) {
     begin_ = s;
     size_ = size;
 }
 
-const char& StringView::operator[](size_t i) const {
+inline const char& StringView::operator[](size_t i) const {
     if (i >= size_) {
         throw std::runtime_error("index out of range");
     }
+    CheckAlive();
     return *(begin_ + i);
 }
 
-size_t StringView::Size() const {
+inline size_t StringView::Size() const {
     return size_;
 }
+
+inline StringView StringView::Substr(size_t pos, size_t count) const {
+    if (pos > size_) {
+        throw std::runtime_error("index out of range");
+    }
+    CheckAlive();
+    auto result = *this;
+    result.begin_ += pos;
+    result.size_ = std::min(count, size_ - pos);
+    return result;
+}
+
+inline size_t StringView::Find(char c, size_t pos) const {
+    CheckAlive();
+    if (pos >= size_) {
+        return kNpos;
+    }
+    size_t i = string_view_internal::ActiveKernels().find_char(begin_ + pos, size_ - pos, c);
+    return i == size_ - pos ? kNpos : pos + i;
+}
+
+inline size_t StringView::Find(StringView needle, size_t pos) const {
+    CheckAlive();
+    needle.CheckAlive();
+    if (pos > size_ || needle.size_ > size_ - pos) {
+        return kNpos;
+    }
+    if (needle.size_ == 0) {
+        return pos;
+    }
+    size_t i = string_view_internal::ActiveKernels().find(begin_ + pos, size_ - pos,
+                                                          needle.begin_, needle.size_);
+    return i == size_ - pos ? kNpos : pos + i;
+}
+
+inline size_t StringView::FindFirstOf(StringView chars, size_t pos) const {
+    CheckAlive();
+    chars.CheckAlive();
+    if (pos >= size_ || chars.size_ == 0) {
+        return kNpos;
+    }
+    size_t i = string_view_internal::ActiveKernels().find_first_of(begin_ + pos, size_ - pos,
+                                                                   chars.begin_, chars.size_);
+    return i == size_ - pos ? kNpos : pos + i;
+}
+
+inline int StringView::Compare(StringView other) const {
+    CheckAlive();
+    other.CheckAlive();
+    size_t common = std::min(size_, other.size_);
+    size_t i = string_view_internal::ActiveKernels().mismatch(begin_, other.begin_, common);
+    if (i < common) {
+        return static_cast<unsigned char>(begin_[i]) -
+               static_cast<unsigned char>(other.begin_[i]);
+    }
+    return size_ < other.size_ ? -1 : size_ > other.size_ ? 1 : 0;
+}
+
+inline bool StringView::StartsWith(StringView prefix) const {
+    CheckAlive();
+    prefix.CheckAlive();
+    return prefix.size_ <= size_ &&
+           string_view_internal::ActiveKernels().mismatch(begin_, prefix.begin_,
+                                                          prefix.size_) == prefix.size_;
+}
+
+inline bool StringView::operator==(StringView other) const {
+    CheckAlive();
+    other.CheckAlive();
+    return size_ == other.size_ &&
+           string_view_internal::ActiveKernels().mismatch(begin_, other.begin_, size_) == size_;
+}
+
+inline size_t StringView::Hash() const {
+    CheckAlive();
+    return string_view_internal::Hash(begin_, size_);
+}
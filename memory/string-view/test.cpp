@@ -1,8 +1,16 @@
 #include <catch.hpp>
 #include <util.h>
 #include <string_view.h>
+#include <split.h>
+#include <rope.h>
 
+#include <algorithm>
+#include <cstdio>
+#include <ranges>
 #include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 TEST_CASE("Constructors") {
     {
@@ -56,3 +64,342 @@ TEST_CASE("Big") {
 
     REQUIRE(count - 1 == static_cast<int>(s.Size()));
 }
+
+namespace {
+
+const SimdLevel kAllLevels[] = {SimdLevel::kScalar, SimdLevel::kSse2, SimdLevel::kAvx2};
+
+int Sign(int x) {
+    return (x > 0) - (x < 0);
+}
+
+}  // namespace
+
+TEST_CASE("Find") {
+    for (auto level : kAllLevels) {
+        ForceSimdLevel(level);
+        std::string a("abacabadabacaba, hello world");
+        StringView s(a);
+        REQUIRE(0u == s.Find('a'));
+        REQUIRE(2u == s.Find('a', 1));
+        REQUIRE(StringView::kNpos == s.Find('z'));
+        REQUIRE(StringView::kNpos == s.Find('a', 100));
+        REQUIRE(4u == s.Find("aba", 1));
+        REQUIRE(7u == s.Find("dab"));
+        REQUIRE(23u == s.Find("world"));
+        REQUIRE(StringView::kNpos == s.Find("worlds"));
+        REQUIRE(5u == s.Find("", 5));
+        REQUIRE(a.size() == s.Find("", a.size()));
+        REQUIRE(StringView::kNpos == s.Find("", a.size() + 1));
+        REQUIRE(3u == s.FindFirstOf("dc"));
+        REQUIRE(15u == s.FindFirstOf(", "));
+        REQUIRE(StringView::kNpos == s.FindFirstOf("xyz"));
+        REQUIRE(StringView::kNpos == s.FindFirstOf(""));
+    }
+}
+
+TEST_CASE("Compare") {
+    for (auto level : kAllLevels) {
+        ForceSimdLevel(level);
+        REQUIRE(0 == StringView("abc").Compare("abc"));
+        REQUIRE(StringView("abc").Compare("abd") < 0);
+        REQUIRE(StringView("abd").Compare("abc") > 0);
+        REQUIRE(StringView("ab").Compare("abc") < 0);
+        REQUIRE(StringView("abc").Compare("ab") > 0);
+        REQUIRE(StringView("\xff").Compare("a") > 0);
+        REQUIRE(StringView("").Compare("") == 0);
+        REQUIRE(StringView("abacaba").StartsWith("abac"));
+        REQUIRE(StringView("abacaba").StartsWith(""));
+        REQUIRE_FALSE(StringView("abacaba").StartsWith("abc"));
+        REQUIRE_FALSE(StringView("aba").StartsWith("abac"));
+        REQUIRE(StringView("abacaba") == StringView("abacaba"));
+        REQUIRE_FALSE(StringView("abacaba") == StringView("abacab"));
+    }
+}
+
+TEST_CASE("Views stay a pointer and a size") {
+    static_assert(sizeof(StringView) == sizeof(const char*) + sizeof(size_t));
+    TrackedString tracked("abacaba");
+    StringView s(tracked, 2);
+    REQUIRE('a' == s[0]);
+    REQUIRE(5u == s.Size());
+    REQUIRE(s.Substr(1, 2) == StringView("ca"));
+    REQUIRE(s.Substr(5).Size() == 0);
+    REQUIRE_THROWS(s.Substr(6));
+}
+
+TEST_CASE("UncheckedAt") {
+    std::string a("abacaba");
+    StringView s(a, 2);
+    REQUIRE(a.data() + 2 == s.Data());
+    for (size_t i = 0; i < s.Size(); ++i) {
+        REQUIRE(s[i] == s.UncheckedAt(i));
+    }
+}
+
+TEST_CASE("Hash") {
+    std::string a("abacaba");
+    REQUIRE(StringView(a).Hash() == StringView("abacaba").Hash());
+    REQUIRE(StringView(a, 0, 3).Hash() == StringView(a, 4).Hash());
+    REQUIRE(StringView("").Hash() != StringView("a").Hash());
+
+    RandomGenerator rnd(745634);
+    std::unordered_set<size_t> hashes;
+    std::unordered_set<std::string> strings;
+    for (int i = 0; i < 100000; ++i) {
+        auto s = rnd.GenString(rnd.GenInt(0, 40), 'a', 'c');
+        if (strings.insert(s).second) {
+            hashes.insert(StringView(s).Hash());
+        }
+    }
+    REQUIRE(strings.size() == hashes.size());
+}
+
+TEST_CASE("Kernels match std::string") {
+    RandomGenerator rnd(93845);
+    for (auto level : kAllLevels) {
+        ForceSimdLevel(level);
+        REQUIRE(ActiveSimdLevel() == std::min(level, DetectSimdLevel()));
+        for (int iter = 0; iter < 3000; ++iter) {
+            // Exactly sized heap buffers, so the sanitizers catch reads past the end.
+            auto text = rnd.GenString(rnd.GenInt(0, 200), 'a', 'd');
+            auto needle = rnd.GenString(rnd.GenInt(1, 6), 'a', 'd');
+            auto chars = rnd.GenString(rnd.GenInt(1, 20), 'd', 'z');
+            std::vector<char> buffer(text.begin(), text.end());
+            StringView s(buffer.data(), buffer.size());
+            size_t pos = rnd.GenInt(0, static_cast<int>(text.size()));
+
+            auto expected = [](size_t i) { return i == std::string::npos ? StringView::kNpos : i; };
+            REQUIRE(expected(text.find(needle[0], pos)) == s.Find(needle[0], pos));
+            REQUIRE(expected(text.find(needle, pos)) == s.Find(needle, pos));
+            REQUIRE(expected(text.find_first_of(chars, pos)) == s.FindFirstOf(chars, pos));
+
+            auto other = text;
+            if (!other.empty() && rnd.GenInt(0, 1)) {
+                other[rnd.GenInt(0, static_cast<int>(other.size()) - 1)] = 'b';
+            }
+            other.resize(rnd.GenInt(0, static_cast<int>(other.size())));
+            std::vector<char> other_buffer(other.begin(), other.end());
+            StringView o(other_buffer.data(), other_buffer.size());
+            REQUIRE(Sign(text.compare(other)) == Sign(s.Compare(o)));
+            REQUIRE(text.starts_with(other) == s.StartsWith(o));
+        }
+    }
+    ForceSimdLevel(DetectSimdLevel());
+}
+
+namespace {
+
+template <class Range>
+std::vector<std::string> Collect(const Range& range) {
+    std::vector<std::string> result;
+    for (StringView field : range) {
+        result.emplace_back(field.Data(), field.Size());
+    }
+    return result;
+}
+
+using Strings = std::vector<std::string>;
+
+}  // namespace
+
+TEST_CASE("Split") {
+    static_assert(std::ranges::forward_range<SplitRange>);
+    REQUIRE(Strings{"aba", "caba", "1"} == Collect(Split("aba caba 1", " ")));
+    REQUIRE(Strings{"aba"} == Collect(Split("aba", " ")));
+    REQUIRE(Strings{""} == Collect(Split("", " ")));
+    REQUIRE(Strings{"", ""} == Collect(Split("full match", "full match")));
+    REQUIRE(Strings{"just", "", "a", "test", ""} == Collect(Split("just  a test ", " ")));
+    REQUIRE(Strings{"hello", "world,no split here", "", "1", ""} ==
+            Collect(Split("hello, world,no split here, , 1, ", ", ")));
+    REQUIRE(Strings{"", "a", "b c", "def", "g h "} == Collect(Split("  a  b c  def  g h ", "  ")));
+    REQUIRE(Strings{"a,b"} == Collect(Split("a,b", "")));
+
+    std::string line("key=value;other=1");
+    auto fields = Split(line, ";");
+    auto it = fields.begin();
+    REQUIRE(line.data() == (*it).Data());
+    REQUIRE(line.data() + 10 == (*++it).Data());
+    REQUIRE(++it == std::default_sentinel);
+}
+
+TEST_CASE("Tokenize") {
+    static_assert(std::ranges::forward_range<TokenizeRange<CharSet>>);
+    REQUIRE(Strings{"just", "a", "test"} == Collect(Tokenize("  just  a\ttest ", " \t")));
+    REQUIRE(Strings{} == Collect(Tokenize("", " ")));
+    REQUIRE(Strings{} == Collect(Tokenize(" , ,", ", ")));
+    REQUIRE(Strings{"abc"} == Collect(Tokenize("abc", ", ")));
+    REQUIRE(Strings{"2024", "01", "02", "10", "20"} ==
+            Collect(Tokenize("[2024-01-02 10:20]", [](char c) { return c < '0' || c > '9'; })));
+    REQUIRE(Strings{"\xff", "\x80"} == Collect(Tokenize("\xff\x01\x80", "\x01")));
+}
+
+TEST_CASE("Split matches a copying split") {
+    RandomGenerator rnd(2384);
+    for (int iter = 0; iter < 2000; ++iter) {
+        auto text = rnd.GenString(rnd.GenInt(0, 100), 'a', 'c');
+        auto delim = rnd.GenString(rnd.GenInt(1, 3), 'a', 'c');
+        Strings expected;
+        size_t begin = 0;
+        for (size_t end; (end = text.find(delim, begin)) != std::string::npos;) {
+            expected.push_back(text.substr(begin, end - begin));
+            begin = end + delim.size();
+        }
+        expected.push_back(text.substr(begin));
+        REQUIRE(expected == Collect(Split(text, delim)));
+    }
+}
+
+TEST_CASE("Tokenize matches a copying tokenizer") {
+    RandomGenerator rnd(7356);
+    for (int iter = 0; iter < 2000; ++iter) {
+        // Long runs of either kind cross the 64-byte blocks the tokenizer scans.
+        std::string text;
+        while (text.size() < static_cast<size_t>(iter % 300)) {
+            text.append(rnd.GenInt(1, 100), rnd.GenInt(0, 2) ? 'a' : ' ');
+            text += rnd.GenString(rnd.GenInt(0, 5), ' ', '#');
+        }
+        Strings expected;
+        for (size_t begin = 0;;) {
+            begin = text.find_first_not_of(" ", begin);
+            if (begin == std::string::npos) {
+                break;
+            }
+            size_t end = std::min(text.find(' ', begin), text.size());
+            expected.push_back(text.substr(begin, end - begin));
+            begin = end;
+        }
+        REQUIRE(expected == Collect(Tokenize(text, " ")));
+    }
+}
+
+TEST_CASE("Rope") {
+    Rope rope("Hello");
+    rope.Append(", ");
+    rope.Append(std::string("world"));
+    rope += Rope("!");
+    REQUIRE(13u == rope.Size());
+    REQUIRE("Hello, world!" == rope.ToString());
+    REQUIRE('w' == rope[7]);
+    REQUIRE_THROWS(rope[13]);
+    REQUIRE("lo, wo" == rope.Substr(3, 6).ToString());
+    REQUIRE("world!" == rope.Substr(7).ToString());
+    REQUIRE("" == rope.Substr(13).ToString());
+    REQUIRE_THROWS(rope.Substr(14));
+    REQUIRE("Hello, world!Hello, world!" == (rope + rope).ToString());
+
+    // "Hello, " shares a buffer with "!", so the chunks are that, "world" and "!".
+    Strings chunks;
+    rope.ForEachChunk(
+        [&chunks](StringView chunk) { chunks.emplace_back(chunk.Data(), chunk.Size()); });
+    REQUIRE(Strings{"Hello, ", "world", "!"} == chunks);
+    REQUIRE(3u == rope.ChunksCount());
+    REQUIRE(3u == rope.Iovecs().size());
+}
+
+TEST_CASE("Rope copies do not overwrite each other") {
+    Rope a("shared");
+    Rope b = a;
+    a.Append(" by a");
+    b.Append(" by b");
+    REQUIRE("shared by a" == a.ToString());
+    REQUIRE("shared by b" == b.ToString());
+    a.Append(a);
+    REQUIRE("shared by ashared by a" == a.ToString());
+}
+
+TEST_CASE("Rope WriteTo") {
+    Rope rope;
+    std::string expected;
+    for (int i = 0; i < 3000; ++i) {
+        auto part = std::to_string(i) + " ";
+        expected += part;
+        if (i % 2) {
+            rope.Append(std::move(part));
+        } else {
+            rope.Append(StringView(part));
+        }
+    }
+    REQUIRE(rope.ChunksCount() > 1024);  // more than one writev call
+
+    FILE* file = std::tmpfile();
+    REQUIRE(file != nullptr);
+    rope.WriteTo(fileno(file));
+    std::rewind(file);
+    std::string written(expected.size() + 1, '\0');
+    written.resize(std::fread(written.data(), 1, written.size(), file));
+    std::fclose(file);
+    REQUIRE(expected == written);
+    REQUIRE_THROWS(rope.WriteTo(-1));
+}
+
+TEST_CASE("Rope matches std::string") {
+    RandomGenerator rnd(57432);
+    std::vector<std::pair<Rope, std::string>> pool{{Rope(), ""}};
+    for (int iter = 0; iter < 3000; ++iter) {
+        auto [rope, expected] = pool[rnd.GenInt(0, static_cast<int>(pool.size()) - 1)];
+        switch (rnd.GenInt(0, 4)) {
+            case 0: {
+                auto s = rnd.GenString(rnd.GenInt(0, 100));
+                rope.Append(StringView(s));
+                expected += s;
+                break;
+            }
+            case 1: {
+                auto s = rnd.GenString(rnd.GenInt(0, 100));
+                expected += s;
+                rope.Append(std::move(s));
+                break;
+            }
+            case 2: {
+                const auto& [other, other_expected] =
+                    pool[rnd.GenInt(0, static_cast<int>(pool.size()) - 1)];
+                rope.Append(other);
+                expected += other_expected;
+                break;
+            }
+            case 3: {
+                size_t pos = rnd.GenInt(0, static_cast<int>(expected.size()));
+                size_t count = rnd.GenInt(0, static_cast<int>(expected.size()));
+                rope = rope.Substr(pos, count);
+                expected = expected.substr(pos, count);
+                break;
+            }
+            default:
+                break;
+        }
+        REQUIRE(expected.size() == rope.Size());
+        if (!expected.empty()) {
+            size_t i = rnd.GenInt(0, static_cast<int>(expected.size()) - 1);
+            REQUIRE(expected[i] == rope[i]);
+        }
+        if (expected.size() < (1 << 20)) {
+            pool.emplace_back(std::move(rope), std::move(expected));
+        }
+    }
+    for (const auto& [rope, expected] : pool) {
+        REQUIRE(expected == rope.ToString());
+    }
+}
+
+TEST_CASE("Rope of many slices stays shallow") {
+    Rope rope;
+    std::string front;
+    std::string back;
+    auto expected = [&front, &back] { return std::string(front.rbegin(), front.rend()) + back; };
+    for (int i = 0; i < 100000; ++i) {
+        auto digit = std::to_string(i % 10);
+        Rope part(digit);
+        // Alternate sides so neither a left nor a right spine builds up.
+        rope = i % 2 ? rope + part : part + rope;
+        (i % 2 ? back : front) += digit;
+        if (i % 10000 == 0) {
+            REQUIRE(expected() == rope.ToString());
+        }
+    }
+    auto all = expected();
+    for (size_t i = 0; i < all.size(); i += 7) {
+        REQUIRE(all[i] == rope[i]);
+    }
+    REQUIRE(all.substr(500, 50000) == rope.Substr(500, 50000).ToString());
+}
@@ -0,0 +1,137 @@
+#include <catch.hpp>
+#include <string_view.h>
+#include <split.h>
+
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Built with STRING_VIEW_CHECK_LIFETIME. Every dangling access below reads freed or
+// reallocated memory unless the check stops it first, so under ASan these tests
+// also prove that the check comes before the read.
+
+namespace {
+
+struct DanglingView : std::logic_error {
+    using std::logic_error::logic_error;
+};
+
+void ThrowDanglingView(const char* message) {
+    throw DanglingView(message);
+}
+
+struct ThrowingHandler {
+    ThrowingHandler() : previous(SetDanglingViewHandler(ThrowDanglingView)) {
+    }
+    ~ThrowingHandler() {
+        SetDanglingViewHandler(previous);
+    }
+    DanglingViewHandler previous;
+};
+
+const std::string kLong = "a string well past the small string buffer, so it lives on the heap";
+
+}  // namespace
+
+TEST_CASE("Views of a live string work") {
+    ThrowingHandler handler;
+    TrackedString s(kLong);
+    StringView view(s, 2, 6);
+    auto copy = view;
+    REQUIRE('s' == view[0]);
+    REQUIRE('t' == copy.UncheckedAt(1));
+    REQUIRE(0u == view.Find("str"));
+    REQUIRE(view == StringView("string"));
+    REQUIRE(view.Substr(3).StartsWith("ing"));
+}
+
+TEST_CASE("Destroyed string") {
+    ThrowingHandler handler;
+    auto tracked = std::make_unique<TrackedString>(kLong);
+    StringView view(*tracked);
+    auto substr = view.Substr(2, 6);
+    tracked.reset();
+
+    REQUIRE(kLong.size() == view.Size());
+    REQUIRE_THROWS_AS(view[0], DanglingView);
+    REQUIRE_THROWS_AS(view.UncheckedAt(0), DanglingView);
+    REQUIRE_THROWS_AS(view.Data(), DanglingView);
+    REQUIRE_THROWS_AS(view.Find('a'), DanglingView);
+    REQUIRE_THROWS_AS(view.Hash(), DanglingView);
+    REQUIRE_THROWS_AS(substr.Substr(1), DanglingView);
+    REQUIRE_THROWS_AS(StringView("a string").Compare(substr), DanglingView);
+    REQUIRE_THROWS_AS(StringView("a string").Find(substr), DanglingView);
+    REQUIRE_THROWS_AS(StringView("a string").StartsWith(substr), DanglingView);
+}
+
+TEST_CASE("Modified string") {
+    ThrowingHandler handler;
+    TrackedString s("short");
+    StringView view(s);
+    s.Mutable() += kLong;
+    REQUIRE_THROWS_AS(view[0], DanglingView);
+
+    StringView fresh(s);
+    REQUIRE('s' == fresh[0]);
+    REQUIRE('s' == StringView(s.Str())[0]);
+}
+
+TEST_CASE("Moved string") {
+    ThrowingHandler handler;
+    TrackedString from(kLong);
+    StringView view(from);
+    TrackedString to(std::move(from));
+    REQUIRE_THROWS_AS(view[0], DanglingView);
+    REQUIRE('a' == StringView(to)[0]);
+
+    TrackedString other("x");
+    StringView other_view(other);
+    StringView to_view(to);
+    other = std::move(to);
+    REQUIRE_THROWS_AS(other_view[0], DanglingView);
+    REQUIRE_THROWS_AS(to_view[0], DanglingView);
+    REQUIRE('a' == StringView(other)[0]);
+}
+
+TEST_CASE("Recycled counters do not revive old views") {
+    ThrowingHandler handler;
+    std::vector<StringView> views;
+    for (int i = 0; i < 5000; ++i) {
+        TrackedString s(kLong);
+        views.emplace_back(s);
+    }
+    TrackedString alive(kLong);
+    for (auto view : views) {
+        REQUIRE_THROWS_AS(view[0], DanglingView);
+    }
+    REQUIRE('a' == StringView(alive)[0]);
+}
+
+TEST_CASE("Split fields keep the tag") {
+    ThrowingHandler handler;
+    auto line = std::make_unique<TrackedString>("first,second," + kLong);
+    std::vector<StringView> fields;
+    for (auto field : Split(*line, ",")) {
+        fields.push_back(field);
+    }
+    for (auto token : Tokenize(*line, ",")) {
+        fields.push_back(token);
+    }
+    REQUIRE(8u == fields.size());
+    REQUIRE(fields[1] == StringView("second"));
+    line.reset();
+    for (auto field : fields) {
+        REQUIRE_THROWS_AS(field.Data(), DanglingView);
+    }
+}
+
+TEST_CASE("Untracked views are never checked") {
+    ThrowingHandler handler;
+    std::string s(kLong);
+    StringView view(s);
+    StringView literal("literal");
+    REQUIRE('a' == view[0]);
+    REQUIRE('l' == literal[0]);
+    REQUIRE(sizeof(StringView) > sizeof(const char*) + sizeof(size_t));
+}